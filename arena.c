@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+/*Every allocation is rounded up to the size of this union so that any type
+can be stored at the start of it.*/
+union arenaalign{
+   long l;
+   double d;
+   void *p;
+};
+
+/*Returns a new chunk that can hold at least size bytes*/
+static arenachunk *createChunk(arena *a, size_t size);
+
+/*Returns the size of a chunk header rounded up to the alignment*/
+static size_t chunkHeader();
+
+arena *createArena(){
+   arena *a;
+   a = (arena *)calloc(1, sizeof(arena));
+   if (a == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      exit(EXIT_FAILURE);
+   }
+   return a;
+}
+
+void *arenaCalloc(arena *a, int quantity, int size){
+   size_t bytes, align = sizeof(union arenaalign);
+   arenachunk *chunk;
+   void *v;
+   bytes = (size_t)quantity * (size_t)size;
+   bytes = ((bytes + align - 1) / align) * align;
+   chunk = a->head;
+   if (chunk == NULL || chunk->size - chunk->used < bytes){
+      chunk = createChunk(a, bytes > ARENACHUNK ? bytes : ARENACHUNK);
+   }
+   v = (char *)chunk + chunkHeader() + chunk->used;
+   chunk->used += bytes;
+   a->requests++;
+   a->bytes += bytes;
+   return v;
+}
+
+char *arenaStrdup(arena *a, char *str){
+   char *copy;
+   copy = (char *)arenaCalloc(a, strlen(str) + 1, sizeof(char));
+   strcpy(copy, str);
+   return copy;
+}
+
+void resetArena(arena *a){
+   arenachunk *chunk, *next;
+   if (a->head == NULL){
+      return;
+   }
+   chunk = a->head->next;
+   while (chunk != NULL){
+      next = chunk->next;
+      free(chunk);
+      chunk = next;
+   }
+   a->head->next = NULL;
+   memset((char *)a->head + chunkHeader(), 0, a->head->used);
+   a->head->used = 0;
+}
+
+void freeArena(arena *a){
+   arenachunk *chunk, *next;
+   chunk = a->head;
+   while (chunk != NULL){
+      next = chunk->next;
+      free(chunk);
+      chunk = next;
+   }
+   free(a);
+}
+
+static arenachunk *createChunk(arena *a, size_t size){
+   arenachunk *chunk;
+   chunk = (arenachunk *)calloc(1, chunkHeader() + size);
+   if (chunk == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      exit(EXIT_FAILURE);
+   }
+   chunk->size = size;
+   chunk->used = 0;
+   /*A large request that gets its own chunk goes behind the current one so the
+   space left in the current chunk can still be used.*/
+   if (a->head != NULL && size > ARENACHUNK){
+      chunk->next = a->head->next;
+      a->head->next = chunk;
+   }
+   else{
+      chunk->next = a->head;
+      a->head = chunk;
+   }
+   a->chunks++;
+   return chunk;
+}
+
+static size_t chunkHeader(){
+   size_t align = sizeof(union arenaalign);
+   return align * ((sizeof(arenachunk) + align - 1) / align);
+}
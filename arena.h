@@ -0,0 +1,46 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENACHUNK 65536
+
+/*A block of memory handed out by moving used towards size. The memory that is
+handed out follows the header.*/
+struct arenachunk{
+   struct arenachunk *next;
+   size_t size;
+   size_t used;
+};
+typedef struct arenachunk arenachunk;
+
+/*A program-scoped allocator. Nothing is freed until the arena is reset or
+freed as a whole.
+chunks counts calls to the system allocator and requests counts allocations
+served by the arena, so the saving can be measured.*/
+struct arena{
+   arenachunk *head;
+   long chunks;
+   long requests;
+   size_t bytes;
+};
+typedef struct arena arena;
+
+/*Returns an empty arena. No chunk is allocated until the first request.*/
+arena *createArena();
+
+/*Returns zeroed memory for quantity items of size bytes from the arena. If the
+current chunk is full a new one is allocated. Quits if allocation fails.*/
+void *arenaCalloc(arena *a, int quantity, int size);
+
+/*Returns a copy of str allocated from the arena*/
+char *arenaStrdup(arena *a, char *str);
+
+/*Releases everything handed out by an arena so its memory can be used again.
+The current chunk is kept and cleared, every other chunk is freed.*/
+void resetArena(arena *a);
+
+/*Frees every chunk of an arena along with the arena itself*/
+void freeArena(arena *a);
+
+#endif
@@ -0,0 +1,457 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bytecode.h"
+
+/*Quits the program when memory cannot be allocated*/
+static void bytecodeQuit();
+
+/*Returns true if x and y have the same bits, so 0 and -0 are different*/
+static bool sameDouble(double x, double y);
+
+/*Returns true for the four arithmetic instructions*/
+static bool isArithmetic(opcode op);
+
+/*Returns the result of an arithmetic instruction on v1 and v2*/
+static double applyArithmetic(opcode op, double v1, double v2);
+
+/*Returns the index of the first instruction of the POLISH expression that is
+stored by the SET at index set*/
+static int expressionStart(instruction *code, int set);
+
+/*Returns the variables read by the operands of an instruction as bits*/
+static unsigned long operandReads(instruction *ins);
+
+/*Returns the bit used for variable v in a set of variables*/
+static unsigned long varBit(int v);
+
+/*Returns zeroed memory for quantity items of size bytes. Quits if allocation
+fails.*/
+static void *bytecodeCalloc(int quantity, int size);
+
+/*Replaces arithmetic on two literals with its result and removes operations
+that leave their left operand unchanged. Returns true if anything changed.*/
+static bool foldConstants(bytecode *b);
+
+/*Replaces reads of a variable with a literal when the variable is only set
+once, outside any loop, to a literal. Reads before that SET see 0. Returns
+true if anything changed.*/
+static bool propagateConstants(bytecode *b);
+
+/*Moves a SET in front of the DO of the loop around it when the loop changes
+neither its variable nor anything its expression reads, and nothing in the
+loop reads its variable before it. Loops always run at least once, so the
+SET still happens. The variables each loop writes are found in one pass and
+the SETs to move in another. Each SET moves in front of the outermost loop it
+does not change in. Returns true if anything moved.*/
+static bool hoistInvariants(bytecode *b);
+
+/*Removes SETs, with their expressions, of variables that nothing reads.
+Returns true if anything was removed.*/
+static bool removeDeadStores(bytecode *b);
+
+bytecode *createBytecode(){
+   bytecode *b;
+   b = (bytecode *)calloc(1, sizeof(bytecode));
+   if (b == NULL){
+      bytecodeQuit();
+   }
+   return b;
+}
+
+int appendInstruction(bytecode *b, opcode op){
+   instruction *grown;
+   if (b->length == b->capacity){
+      b->capacity = (b->capacity == 0) ? BYTECODESTART : b->capacity * 2;
+      grown = (instruction *)realloc(b->code, b->capacity * sizeof(instruction));
+      if (grown == NULL){
+         bytecodeQuit();
+      }
+      b->code = grown;
+   }
+   memset(&b->code[b->length], 0, sizeof(instruction));
+   b->code[b->length].op = op;
+   return b->length++;
+}
+
+void openLoop(bytecode *b, int start){
+   if (b->depth == b->loopCapacity){
+      b->loopCapacity = (b->loopCapacity == 0) ? BYTECODESTART :
+         b->loopCapacity * 2;
+      b->loops = (int *)realloc(b->loops, b->loopCapacity * sizeof(int));
+      if (b->loops == NULL){
+         bytecodeQuit();
+      }
+   }
+   b->code[start].depth = b->depth;
+   b->loops[b->depth] = start;
+   if (++b->depth > b->maxDepth){
+      b->maxDepth = b->depth;
+   }
+}
+
+void linkLoops(bytecode *b){
+   int i, start;
+   b->depth = 0;
+   for (i = 0; i < b->length; i++){
+      if (b->code[i].op == OP_DO){
+         openLoop(b, i);
+      }
+      else if (b->code[i].op == OP_LOOP){
+         start = b->loops[--b->depth];
+         b->code[i].depth = b->code[start].depth;
+         b->code[i].jump = start + 1;
+         b->code[start].jump = i;
+      }
+   }
+}
+
+void markMotionLoops(bytecode *b){
+   int i, j, longest = 0;
+   opcode op;
+   for (i = 0; i < b->length; i++){
+      if (b->code[i].op != OP_DO){
+         continue;
+      }
+      b->code[i].motion = true;
+      for (j = i + 1; j < b->code[i].jump && b->code[i].motion == true; j++){
+         op = b->code[j].op;
+         if ((op != OP_FD && op != OP_RT && op != OP_LT)
+            || (b->code[j].arg.isVar == true
+            && b->code[j].arg.varIndex == b->code[i].varIndex)){
+            b->code[i].motion = false;
+         }
+      }
+      if (b->code[i].motion == true && j - i - 1 > longest){
+         longest = j - i - 1;
+      }
+   }
+   free(b->moves);
+   b->moves = (double *)bytecodeCalloc(longest, sizeof(double));
+}
+
+void optimiseBytecode(bytecode *b){
+   bool changed = true;
+   while (changed == true){
+      changed = false;
+      if (foldConstants(b) == true){
+         changed = true;
+      }
+      if (propagateConstants(b) == true){
+         changed = true;
+      }
+      if (hoistInvariants(b) == true){
+         changed = true;
+      }
+      if (removeDeadStores(b) == true){
+         changed = true;
+      }
+   }
+   markMotionLoops(b);
+}
+
+void freeBytecode(bytecode *b){
+   if (b == NULL){
+      return;
+   }
+   free(b->code);
+   free(b->loops);
+   free(b->moves);
+   free(b);
+}
+
+static bool foldConstants(bytecode *b){
+   instruction *code = b->code, *x, *y;
+   opcode op;
+   int r, w = 0;
+   for (r = 0; r < b->length; r++){
+      op = code[r].op;
+      if (isArithmetic(op) && w >= 2 && code[w - 2].op == OP_PUSH
+         && code[w - 1].op == OP_PUSH){
+         x = &code[w - 2];
+         y = &code[w - 1];
+         if (x->arg.isVar == false && y->arg.isVar == false){
+            x->arg.value = applyArithmetic(op, x->arg.value, y->arg.value);
+            w--;
+            continue;
+         }
+         if (y->arg.isVar == false && (((op == OP_MUL || op == OP_DIV)
+            && sameDouble(y->arg.value, 1)) || (op == OP_SUB
+            && sameDouble(y->arg.value, 0)))){
+            w--;
+            continue;
+         }
+         if (x->arg.isVar == false && op == OP_MUL
+            && sameDouble(x->arg.value, 1)){
+            *x = *y;
+            w--;
+            continue;
+         }
+      }
+      code[w++] = code[r];
+   }
+   if (w != b->length){
+      b->length = w;
+      linkLoops(b);
+      return true;
+   }
+   return false;
+}
+
+static bool propagateConstants(bytecode *b){
+   instruction *code = b->code;
+   operand *reads[2];
+   int sets[VARCOUNT], where[VARCOUNT], i, j, v, depth = 0;
+   bool constant[VARCOUNT], changed = false;
+   for (v = 0; v < VARCOUNT; v++){
+      sets[v] = 0;
+      where[v] = -1;
+      constant[v] = true;
+   }
+   for (i = 0; i < b->length; i++){
+      v = code[i].varIndex;
+      if (code[i].op == OP_DO){
+         constant[v] = false;
+         depth++;
+      }
+      else if (code[i].op == OP_LOOP){
+         depth--;
+      }
+      else if (code[i].op == OP_SET){
+         sets[v]++;
+         if (depth == 0 && code[i - 1].op == OP_PUSH
+            && code[i - 1].arg.isVar == false){
+            where[v] = i;
+         }
+         else{
+            constant[v] = false;
+         }
+      }
+   }
+   for (i = 0; i < b->length; i++){
+      reads[0] = &code[i].arg;
+      reads[1] = &code[i].limit;
+      for (j = 0; j < 2; j++){
+         v = reads[j]->varIndex;
+         if (reads[j]->isVar == true && constant[v] == true && sets[v] < 2){
+            reads[j]->isVar = false;
+            reads[j]->value = (where[v] < 0 || i < where[v]) ? 0 :
+               code[where[v] - 1].arg.value;
+            changed = true;
+         }
+      }
+   }
+   return changed;
+}
+
+static bool hoistInvariants(bytecode *b){
+   instruction *code = b->code, *out;
+   unsigned long *once, *more, *reads, inputs, seen, bit;
+   int *loops, *begin, *head, *tail, *next, i, j, k = 0, w = 0, level, loop;
+   int child;
+   char *moved;
+   bool changed = false;
+   once = (unsigned long *)bytecodeCalloc(b->length, sizeof(unsigned long));
+   more = (unsigned long *)bytecodeCalloc(b->length, sizeof(unsigned long));
+   reads = (unsigned long *)bytecodeCalloc(b->maxDepth + 1,
+      sizeof(unsigned long));
+   loops = (int *)bytecodeCalloc(b->maxDepth + 1, sizeof(int));
+   begin = (int *)bytecodeCalloc(b->length, sizeof(int));
+   head = (int *)bytecodeCalloc(b->length, sizeof(int));
+   tail = (int *)bytecodeCalloc(b->length, sizeof(int));
+   next = (int *)bytecodeCalloc(b->length, sizeof(int));
+   moved = (char *)bytecodeCalloc(b->length, sizeof(char));
+   /*Find the variables each loop body writes once and more than once. The
+   loop variable counts as written more than once.*/
+   for (i = 0; i < b->length; i++){
+      head[i] = -1;
+      if (code[i].op == OP_DO){
+         loops[k++] = i;
+         once[i] = more[i] = varBit(code[i].varIndex);
+      }
+      else if (code[i].op == OP_SET && k > 0){
+         loop = loops[k - 1];
+         bit = varBit(code[i].varIndex);
+         more[loop] |= once[loop] & bit;
+         once[loop] |= bit;
+      }
+      else if (code[i].op == OP_LOOP && --k > 0){
+         loop = loops[k - 1];
+         child = loops[k];
+         more[loop] |= more[child] | (once[loop] & once[child]);
+         once[loop] |= once[child];
+      }
+   }
+   /*Find the SETs that can move in front of a loop around them, keeping track
+   of the variables read so far in each open loop*/
+   for (i = 0; i < b->length; i++){
+      if (code[i].op == OP_DO){
+         if (k > 0){
+            reads[k - 1] |= operandReads(&code[i]);
+         }
+         loops[k] = i;
+         reads[k++] = 0;
+      }
+      else if (code[i].op == OP_LOOP){
+         if (--k > 0){
+            reads[k - 1] |= reads[k] | varBit(code[i].varIndex);
+         }
+      }
+      else if (k > 0){
+         reads[k - 1] |= operandReads(&code[i]);
+         if (code[i].op != OP_SET){
+            continue;
+         }
+         bit = varBit(code[i].varIndex);
+         begin[i] = expressionStart(code, i);
+         inputs = 0;
+         for (j = begin[i]; j < i; j++){
+            inputs |= operandReads(&code[j]);
+         }
+         seen = 0;
+         loop = -1;
+         for (level = k - 1; level >= 0; level--){
+            seen |= reads[level];
+            if ((more[loops[level]] & bit) || (seen & bit)
+               || (operandReads(&code[loops[level]]) & bit)
+               || (inputs & once[loops[level]])){
+               break;
+            }
+            loop = loops[level];
+         }
+         if (loop < 0){
+            continue;
+         }
+         for (j = begin[i]; j <= i; j++){
+            moved[j] = 1;
+         }
+         next[i] = -1;
+         if (head[loop] < 0){
+            head[loop] = i;
+         }
+         else{
+            next[tail[loop]] = i;
+         }
+         tail[loop] = i;
+         changed = true;
+      }
+   }
+   if (changed == true){
+      out = (instruction *)bytecodeCalloc(b->capacity, sizeof(instruction));
+      for (i = 0; i < b->length; i++){
+         if (moved[i]){
+            continue;
+         }
+         for (j = head[i]; j >= 0; j = next[j]){
+            memcpy(&out[w], &code[begin[j]],
+               (j + 1 - begin[j]) * sizeof(instruction));
+            w += j + 1 - begin[j];
+         }
+         out[w++] = code[i];
+      }
+      free(b->code);
+      b->code = out;
+      linkLoops(b);
+   }
+   free(once);
+   free(more);
+   free(reads);
+   free(loops);
+   free(begin);
+   free(head);
+   free(tail);
+   free(next);
+   free(moved);
+   return changed;
+}
+
+static bool removeDeadStores(bytecode *b){
+   instruction *code = b->code;
+   bool read[VARCOUNT];
+   int r, w = 0, v;
+   for (v = 0; v < VARCOUNT; v++){
+      read[v] = false;
+   }
+   for (r = 0; r < b->length; r++){
+      if (code[r].arg.isVar == true){
+         read[code[r].arg.varIndex] = true;
+      }
+      if (code[r].limit.isVar == true){
+         read[code[r].limit.varIndex] = true;
+      }
+      if (code[r].op == OP_DO){
+         read[code[r].varIndex] = true;
+      }
+   }
+   for (r = 0; r < b->length; r++){
+      code[w++] = code[r];
+      if (code[r].op == OP_SET && read[code[r].varIndex] == false){
+         w = expressionStart(code, w - 1);
+      }
+   }
+   if (w != b->length){
+      b->length = w;
+      linkLoops(b);
+      return true;
+   }
+   return false;
+}
+
+static int expressionStart(instruction *code, int set){
+   int i = set, need = 1;
+   while (need > 0){
+      i--;
+      need += (code[i].op == OP_PUSH) ? -1 : 1;
+   }
+   return i;
+}
+
+static unsigned long operandReads(instruction *ins){
+   unsigned long vars = 0;
+   if (ins->arg.isVar == true){
+      vars |= varBit(ins->arg.varIndex);
+   }
+   if (ins->limit.isVar == true){
+      vars |= varBit(ins->limit.varIndex);
+   }
+   return vars;
+}
+
+static unsigned long varBit(int v){
+   return 1UL << v;
+}
+
+static void *bytecodeCalloc(int quantity, int size){
+   void *v;
+   v = calloc(quantity > 0 ? quantity : 1, size);
+   if (v == NULL){
+      bytecodeQuit();
+   }
+   return v;
+}
+
+static bool sameDouble(double x, double y){
+   return memcmp(&x, &y, sizeof(double)) == 0;
+}
+
+static bool isArithmetic(opcode op){
+   return op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV;
+}
+
+static double applyArithmetic(opcode op, double v1, double v2){
+   switch (op){
+      case OP_ADD:
+         return v1 + v2;
+      case OP_SUB:
+         return v1 - v2;
+      case OP_MUL:
+         return v1 * v2;
+      default:
+         return v1 / v2;
+   }
+}
+
+static void bytecodeQuit(){
+   fprintf(stderr, "Could not allocate memory...exiting\n");
+   exit(EXIT_FAILURE);
+}
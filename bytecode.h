@@ -0,0 +1,86 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "General/general.h"
+
+#define BYTECODESTART 30
+#define VARCOUNT 26
+
+enum opcode {OP_FD, OP_RT, OP_LT, OP_DO, OP_LOOP, OP_PUSH, OP_ADD, OP_SUB,
+   OP_MUL, OP_DIV, OP_SET};
+typedef enum opcode opcode;
+
+/*A VARNUM resolved at compile time. Literals hold their value, variables hold
+the index into the program vars array.*/
+struct operand{
+   bool isVar;
+   int varIndex;
+   double value;
+};
+typedef struct operand operand;
+
+/*A single VM instruction. jump holds the index of the matching LOOP for DO and
+the first body instruction for LOOP. depth selects the slot that holds the TO
+value of the loop while it runs. motion is set on a DO whose body only moves
+the turtle by amounts that do not change while the loop runs. source is the
+number of the word it was compiled from, as in error messages, or 0.*/
+struct instruction{
+   opcode op;
+   operand arg;
+   operand limit;
+   int varIndex;
+   int jump;
+   int depth;
+   bool motion;
+   int source;
+};
+typedef struct instruction instruction;
+
+/*loops holds the index of the DO instruction of each loop that has been opened
+but not yet closed, so depth is the number of open loops. polishTop is the
+number of values the POLISH expression being compiled holds, and polishDepth
+is the most values any POLISH expression holds at once. moves has room for
+the body of the longest motion loop.*/
+struct bytecode{
+   instruction *code;
+   int length;
+   int capacity;
+   int *loops;
+   int loopCapacity;
+   int depth;
+   int maxDepth;
+   int polishTop;
+   int polishDepth;
+   double *moves;
+};
+typedef struct bytecode bytecode;
+
+/*Returns an empty bytecode struct that will hold compiled instructions*/
+bytecode *createBytecode();
+
+/*Appends a zeroed instruction and returns its index*/
+int appendInstruction(bytecode *b, opcode op);
+
+/*Pushes the DO instruction at index start onto the open loops*/
+void openLoop(bytecode *b, int start);
+
+/*Sets the jump and depth of every DO and its matching LOOP from their
+positions. Used after instructions have been moved or removed.*/
+void linkLoops(bytecode *b);
+
+/*Sets motion on every DO whose body is only FD, RT and LT instructions that do
+not read the loop variable, and makes room in moves for the longest body*/
+void markMotionLoops(bytecode *b);
+
+/*Rewrites the bytecode so that it runs faster but draws exactly the same
+thing. Constant POLISH expressions are folded, variables with a single
+constant value are replaced by it, SETs that do not change inside a loop are
+moved in front of it, x*1, 1*x, x/1 and x-0 become x, and SETs that are never
+read are removed. The passes repeat until none of them changes anything, and
+then the loops that only move the turtle are marked.*/
+void optimiseBytecode(bytecode *b);
+
+/*Frees memory allocated for a bytecode structure*/
+void freeBytecode(bytecode *b);
+
+#endif
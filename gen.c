@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "rng.h"
+
+#define GENINSTRUCTIONS 1000
+#define GENDEPTH 3
+#define GENMAXDEPTH 13
+#define GENPOLISH 3
+#define GENLOOPMAX 8
+#define GENBODYMAX 8
+#define GENLOOPCHANCE 0.2
+#define GENLITERALMAX 100
+#define GENFACTORMAX 9
+#define GENFIRSTSET 'N'
+#define GENSETVARS 12
+#define GENOUTERVAR 'Z'
+#define GENWORD 64
+#define GENMESSAGE 200
+#define GENINDENT 3
+#define GENERRORS 6
+#define STREQ(A, B) (strcmp(A, B) == 0)
+
+enum generror {GEN_INSTRUCTION, GEN_FROM, GEN_ASSIGN, GEN_OPERATOR,
+   GEN_POLISH, GEN_END};
+typedef enum generror generror;
+
+/*The settings and progress of one generated program. Every choice is drawn
+from the counter-based generator with draws as the counter, so a pass that
+only counts makes exactly the choices of the pass that writes. out is NULL
+while counting. errorAt is the instruction that is made invalid, or -1 for a
+valid program, and message holds the error the interpreter should report.*/
+struct generator{
+   unsigned long seed;
+   unsigned long draws;
+   long instructions;
+   int depth;
+   int polish;
+   int extension;
+   double segments;
+   long errorAt;
+   generror error;
+   FILE *out;
+   int lineStart;
+   long words;
+   long emitted;
+   double drawn;
+   char last[GENWORD];
+   char message[GENMESSAGE];
+};
+typedef struct generator generator;
+
+/*Sets the generator from the command line. Returns 0 if the arguments are
+not of the form
+[-n INSTRUCTIONS] [-d DEPTH] [-p POLISH] [-x PERCENT] [-s SEGMENTS]
+[-r SEED] [-e] [-m MESSAGEFILE] [-o OUTPUT.ttl]*/
+int parseGenOptions(int argc, char **argv, generator *g, char **output,
+   char **messages);
+
+/*Writes a whole program to out, or only counts its words and segments if out
+is NULL. With a segment target the program is wrapped in a loop that repeats
+it often enough to draw at least that many segments.*/
+void generateProgram(generator *g, FILE *out, double repeats);
+
+/*Writes count instructions at the given DO depth. multiplier is the number
+of times each of them runs.*/
+void generateBlock(generator *g, int depth, long count, double multiplier);
+
+/*Writes one instruction that is not a DO, or the invalid instruction if it
+is the one chosen to hold the error*/
+void generateInstruction(generator *g, int depth, double multiplier);
+
+/*Writes an instruction of the extension: JUMP, COLOUR or a move by RANDOM*/
+void generateExtension(generator *g);
+
+/*Writes a SET with a POLISH expression of g->polish operands*/
+void generateSet(generator *g, int depth);
+
+/*Writes an invalid instruction and records the error it causes*/
+void generateError(generator *g, int depth);
+
+/*Writes a literal or a variable that has a value at this depth*/
+void generateOperand(generator *g, int depth, int small);
+
+/*Writes a word, separated from the last one by a space*/
+void emitWord(generator *g, char *word);
+
+/*Writes a number as a word*/
+void emitNumber(generator *g, long n);
+
+/*Starts a line indented for depth, or ends the current one*/
+void startLine(generator *g, int depth);
+void endLine(generator *g);
+
+/*Records the message the interpreter gives for an error at the next word*/
+void expectError(generator *g, char *message, char *word, long index);
+
+/*Returns a whole number from 0 to n - 1 and moves to the next draw*/
+int pick(generator *g, int n);
+
+/*Returns a number in [0, 1) and moves to the next draw*/
+double chance(generator *g);
+
+void testGen(void);
+
+int main(int argc, char **argv){
+   generator g;
+   char *output, *messages;
+   FILE *out, *expected;
+   double repeats = 1.0;
+   testGen();
+   if (parseGenOptions(argc, argv, &g, &output, &messages) == 0){
+      fprintf(stderr, "Usage: %s [-n INSTRUCTIONS] [-d DEPTH] [-p POLISH] "
+         "[-x PERCENT] [-s SEGMENTS] [-r SEED] [-e] [-m MESSAGEFILE] "
+         "[-o OUTPUT.ttl]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (g.segments > 0.0){
+      generateProgram(&g, NULL, 1.0);
+      if (g.drawn > 0.0){
+         repeats = ceil(g.segments / g.drawn);
+      }
+   }
+   out = (output == NULL) ? stdout : fopen(output, "w");
+   if (out == NULL){
+      fprintf(stderr, "Could not open %s...exiting\n", output);
+      return EXIT_FAILURE;
+   }
+   generateProgram(&g, out, repeats);
+   if (out != stdout){
+      fclose(out);
+   }
+   if (g.errorAt >= 0){
+      expected = (messages == NULL) ? stderr : fopen(messages, "w");
+      if (expected == NULL){
+         fprintf(stderr, "Could not open %s...exiting\n", messages);
+         return EXIT_FAILURE;
+      }
+      fprintf(expected, "%s\n", g.message);
+      if (expected != stderr){
+         fclose(expected);
+      }
+   }
+   return 0;
+}
+
+int parseGenOptions(int argc, char **argv, generator *g, char **output,
+   char **messages){
+   int i;
+   int invalid = 0;
+   char extra;
+   memset(g, 0, sizeof(generator));
+   g->instructions = GENINSTRUCTIONS;
+   g->depth = GENDEPTH;
+   g->polish = GENPOLISH;
+   g->seed = 1;
+   *output = NULL;
+   *messages = NULL;
+   for (i = 1; i < argc; i++){
+      if (STREQ(argv[i], "-e")){
+         invalid = 1;
+      }
+      else if (i + 1 >= argc){
+         return 0;
+      }
+      else if (STREQ(argv[i], "-n")){
+         if (sscanf(argv[++i], "%ld%c", &g->instructions, &extra) != 1
+            || g->instructions < 1){
+            return 0;
+         }
+      }
+      else if (STREQ(argv[i], "-d")){
+         if (sscanf(argv[++i], "%d%c", &g->depth, &extra) != 1
+            || g->depth < 0 || g->depth > GENMAXDEPTH){
+            return 0;
+         }
+      }
+      else if (STREQ(argv[i], "-p")){
+         if (sscanf(argv[++i], "%d%c", &g->polish, &extra) != 1
+            || g->polish < 1){
+            return 0;
+         }
+      }
+      else if (STREQ(argv[i], "-x")){
+         if (sscanf(argv[++i], "%d%c", &g->extension, &extra) != 1
+            || g->extension < 0 || g->extension > 100){
+            return 0;
+         }
+      }
+      else if (STREQ(argv[i], "-s")){
+         if (sscanf(argv[++i], "%lf%c", &g->segments, &extra) != 1
+            || g->segments < 0.0){
+            return 0;
+         }
+      }
+      else if (STREQ(argv[i], "-r")){
+         if (sscanf(argv[++i], "%lu%c", &g->seed, &extra) != 1){
+            return 0;
+         }
+      }
+      else if (STREQ(argv[i], "-m")){
+         *messages = argv[++i];
+      }
+      else if (STREQ(argv[i], "-o")){
+         *output = argv[++i];
+      }
+      else{
+         return 0;
+      }
+   }
+   g->errorAt = -1;
+   if (invalid){
+      g->errorAt = randomRange(g->seed, 0, 1, 0, g->instructions - 1);
+      g->error = (generror)randomRange(g->seed, 0, 2, 0, GENERRORS - 1);
+   }
+   return 1;
+}
+
+void generateProgram(generator *g, FILE *out, double repeats){
+   static char outer[2] = {GENOUTERVAR, '\0'};
+   g->out = out;
+   g->draws = 0;
+   g->words = 0;
+   g->emitted = 0;
+   g->drawn = 0.0;
+   g->lineStart = 1;
+   g->message[0] = '\0';
+   startLine(g, 0);
+   emitWord(g, "{");
+   endLine(g);
+   if (repeats > 1.0){
+      startLine(g, 0);
+      emitWord(g, "DO");
+      emitWord(g, outer);
+      emitWord(g, "FROM");
+      emitWord(g, "1");
+      emitWord(g, "TO");
+      emitNumber(g, (long)repeats);
+      emitWord(g, "{");
+      endLine(g);
+      generateBlock(g, 0, g->instructions, repeats);
+      startLine(g, 0);
+      emitWord(g, "}");
+      endLine(g);
+   }
+   else{
+      generateBlock(g, 0, g->instructions, 1.0);
+   }
+   if (g->errorAt >= 0 && g->error == GEN_END){
+      expectError(g, "Error: Program did not end with }.", g->last, g->words);
+      return;
+   }
+   startLine(g, 0);
+   emitWord(g, "}");
+   endLine(g);
+}
+
+void generateBlock(generator *g, int depth, long count, double multiplier){
+   char var[2];
+   long body;
+   int loops;
+   while (count > 0){
+      if ((g->emitted != g->errorAt || g->error == GEN_END)
+         && depth < g->depth && count >= 2 && chance(g) < GENLOOPCHANCE){
+         body = 1 + pick(g, (int)((count - 1 < GENBODYMAX) ? count - 1
+            : GENBODYMAX));
+         loops = 1 + pick(g, GENLOOPMAX);
+         var[0] = 'A' + depth;
+         var[1] = '\0';
+         startLine(g, depth);
+         emitWord(g, "DO");
+         emitWord(g, var);
+         emitWord(g, "FROM");
+         emitWord(g, "1");
+         emitWord(g, "TO");
+         emitNumber(g, loops);
+         emitWord(g, "{");
+         endLine(g);
+         g->emitted++;
+         generateBlock(g, depth + 1, body, multiplier * loops);
+         startLine(g, depth);
+         emitWord(g, "}");
+         endLine(g);
+         count -= body + 1;
+      }
+      else{
+         generateInstruction(g, depth, multiplier);
+         count--;
+      }
+   }
+}
+
+void generateInstruction(generator *g, int depth, double multiplier){
+   static char *moves[3] = {"FD", "RT", "LT"};
+   int kind;
+   startLine(g, depth);
+   if (g->emitted == g->errorAt && g->error != GEN_END){
+      generateError(g, depth);
+   }
+   else if (g->extension > 0 && pick(g, 100) < g->extension){
+      generateExtension(g);
+   }
+   else if ((kind = pick(g, 4)) == 3){
+      generateSet(g, depth);
+   }
+   else{
+      emitWord(g, moves[kind]);
+      generateOperand(g, depth, 0);
+      if (kind == 0){
+         g->drawn += multiplier;
+      }
+   }
+   endLine(g);
+   g->emitted++;
+}
+
+void generateExtension(generator *g){
+   static char *colours[4] = {"RED", "BLUE", "GREEN", "RANDCOL"};
+   int i;
+   switch (pick(g, 4)){
+      case 0:
+         emitWord(g, "JUMP");
+         emitNumber(g, pick(g, 2 * GENLITERALMAX + 1) - GENLITERALMAX);
+         emitWord(g, ",");
+         emitNumber(g, pick(g, 2 * GENLITERALMAX + 1) - GENLITERALMAX);
+         break;
+      case 1:
+         emitWord(g, "COLOUR");
+         emitWord(g, colours[pick(g, 4)]);
+         break;
+      case 2:
+         emitWord(g, "COLOUR");
+         for (i = 0; i < 3; i++){
+            if (pick(g, 2) == 0){
+               emitWord(g, "RANDOM");
+            }
+            else{
+               emitNumber(g, pick(g, 256));
+            }
+         }
+         break;
+      default:
+         emitWord(g, (pick(g, 2) == 0) ? "FD" : "RT");
+         emitWord(g, "RANDOM");
+         break;
+   }
+}
+
+void generateSet(generator *g, int depth){
+   static char *ops[4] = {"+", "-", "*", "/"};
+   char var[2];
+   int i, op;
+   var[0] = GENFIRSTSET + pick(g, GENSETVARS);
+   var[1] = '\0';
+   emitWord(g, "SET");
+   emitWord(g, var);
+   emitWord(g, ":=");
+   generateOperand(g, depth, 0);
+   for (i = 1; i < g->polish; i++){
+      op = pick(g, 4);
+      generateOperand(g, depth, op >= 2);
+      emitWord(g, ops[op]);
+   }
+   emitWord(g, ";");
+}
+
+void generateError(generator *g, int depth){
+   char var[2];
+   var[0] = (depth < GENMAXDEPTH) ? 'A' + depth : GENFIRSTSET;
+   var[1] = '\0';
+   switch (g->error){
+      case GEN_INSTRUCTION:
+         expectError(g, "Error: No proper instruction found.", "XX",
+            g->words + 1);
+         emitWord(g, "XX");
+         emitWord(g, "1");
+         break;
+      case GEN_FROM:
+         emitWord(g, "DO");
+         emitWord(g, var);
+         expectError(g, "Error: Expected FROM in DO instruction.", "FRUM",
+            g->words + 1);
+         emitWord(g, "FRUM");
+         emitWord(g, "1");
+         emitWord(g, "TO");
+         emitWord(g, "2");
+         emitWord(g, "{");
+         emitWord(g, "}");
+         break;
+      case GEN_ASSIGN:
+         emitWord(g, "SET");
+         emitWord(g, var);
+         expectError(g, "Error: Expected := in SET instruction.", "=",
+            g->words + 1);
+         emitWord(g, "=");
+         emitWord(g, "1");
+         emitWord(g, ";");
+         break;
+      case GEN_OPERATOR:
+         emitWord(g, "SET");
+         emitWord(g, var);
+         emitWord(g, ":=");
+         expectError(g, "Error: OP operated on a non-existant number.", "+",
+            g->words + 1);
+         emitWord(g, "+");
+         emitWord(g, ";");
+         break;
+      default:
+         emitWord(g, "SET");
+         emitWord(g, var);
+         emitWord(g, ":=");
+         emitWord(g, "1");
+         emitWord(g, "2");
+         expectError(g, "Error: Incorrect POLISH notation.", ";",
+            g->words + 1);
+         emitWord(g, ";");
+         break;
+   }
+}
+
+void generateOperand(generator *g, int depth, int small){
+   char var[2];
+   int kind = pick(g, 3);
+   var[1] = '\0';
+   if (kind == 0 && depth > 0){
+      var[0] = 'A' + pick(g, depth);
+      emitWord(g, var);
+   }
+   else if (kind == 1 && small == 0){
+      var[0] = GENFIRSTSET + pick(g, GENSETVARS);
+      emitWord(g, var);
+   }
+   else{
+      emitNumber(g, 1 + pick(g, small ? GENFACTORMAX : GENLITERALMAX));
+   }
+}
+
+void emitWord(generator *g, char *word){
+   if (g->out != NULL){
+      if (g->lineStart == 0){
+         fputc(' ', g->out);
+      }
+      fputs(word, g->out);
+   }
+   g->lineStart = 0;
+   g->words++;
+   strncpy(g->last, word, GENWORD - 1);
+   g->last[GENWORD - 1] = '\0';
+}
+
+void emitNumber(generator *g, long n){
+   char number[GENWORD];
+   sprintf(number, "%ld", n);
+   emitWord(g, number);
+}
+
+void startLine(generator *g, int depth){
+   int i;
+   if (g->out != NULL){
+      for (i = 0; i < depth * GENINDENT; i++){
+         fputc(' ', g->out);
+      }
+   }
+   g->lineStart = 1;
+}
+
+void endLine(generator *g){
+   if (g->out != NULL){
+      fputc('\n', g->out);
+   }
+   g->lineStart = 1;
+}
+
+void expectError(generator *g, char *message, char *word, long index){
+   sprintf(g->message, "%s Issue encountered at word %ld: %s.", message,
+      index, word);
+}
+
+int pick(generator *g, int n){
+   return (int)randomRange(g->seed, 0, 3 + g->draws++, 0, n - 1);
+}
+
+double chance(generator *g){
+   return randomUnit(g->seed, 0, 3 + g->draws++);
+}
+
+void testGen(void){
+   generator g;
+   FILE *first, *second;
+   char *args[9] = {"gen", "-n", "200", "-d", "4", "-r", "7", "-s", "5000"};
+   char *output, *messages;
+   long words;
+   double drawn;
+   int a, b, i, j;
+   unsigned long bits[RANDOMWORDS];
+   double value, last, again;
+   assert(parseGenOptions(9, args, &g, &output, &messages) == 1);
+   assert(g.instructions == 200 && g.depth == 4 && g.seed == 7);
+   assert(output == NULL && messages == NULL && g.errorAt == -1);
+   assert(parseGenOptions(2, args, &g, &output, &messages) == 0);
+   assert(parseGenOptions(4, args + 1, &g, &output, &messages) == 0);
+
+   /*Test the counting pass makes the same choices as the writing pass and
+   that the same seed writes the same program*/
+   assert(parseGenOptions(9, args, &g, &output, &messages) == 1);
+   generateProgram(&g, NULL, 1.0);
+   words = g.words;
+   drawn = g.drawn;
+   assert(drawn > 0.0 && g.emitted == 200);
+   first = tmpfile();
+   second = tmpfile();
+   assert(first != NULL && second != NULL);
+   generateProgram(&g, first, 1.0);
+   assert(g.words == words && fabs(g.drawn - drawn) < 0.5);
+   generateProgram(&g, second, 1.0);
+   rewind(first);
+   rewind(second);
+   do{
+      a = fgetc(first);
+      b = fgetc(second);
+      assert(a == b);
+   } while (a != EOF);
+   fclose(first);
+   fclose(second);
+
+   /*Test a repeated program wraps the body in one more loop*/
+   generateProgram(&g, NULL, 3.0);
+   assert(g.words == words + 8 && fabs(g.drawn - 3.0 * drawn) < 0.5);
+
+   /*Test an invalid program records the error of the last word*/
+   g.errorAt = 0;
+   g.error = GEN_END;
+   generateProgram(&g, NULL, 1.0);
+   assert(g.words == words - 1);
+   assert(strstr(g.message, "did not end with }.") != NULL);
+   g.error = GEN_INSTRUCTION;
+   generateProgram(&g, NULL, 1.0);
+   assert(STREQ(g.message, "Error: No proper instruction found. Issue "
+      "encountered at word 2: XX."));
+
+   /*Test random draws depend only on the seed and their position*/
+   last = -1.0;
+   randomBits(0, 0, 0, bits);
+   assert(bits[0] == 0x6627e8d5UL && bits[1] == 0xe169c58dUL);
+   assert(bits[2] == 0xbc57ac4cUL && bits[3] == 0x9b00dbd8UL);
+   for (i = 0; i < 1000; i++){
+      value = randomUnit(42, i % 7, i);
+      assert(value >= 0.0 && value < 1.0);
+      assert(memcmp(&value, &last, sizeof(double)) != 0);
+      last = value;
+      again = randomUnit(42, i % 7, i);
+      assert(memcmp(&value, &again, sizeof(double)) == 0);
+      j = (int)randomRange(42, i % 7, i, -3, 3);
+      assert(j >= -3 && j <= 3);
+   }
+   assert(fabs(randomUnit(42, 1, 5) - randomUnit(43, 1, 5)) > 0.0);
+   assert(fabs(randomUnit(42, 1, 5) - randomUnit(42, 2, 5)) > 0.0);
+   assert(fabs(randomUnit(42, 1, 5) - randomUnit(42, 1, 6)) > 0.0);
+   assert(randomRange(42, 1, 5, 9, 9) == 9);
+}
@@ -1,31 +1,60 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
 #include "neillsdl2.h"
-#include "Stack/stack.h"
+#include "arena.h"
+#include "lexer.h"
+#include "raster.h"
+#include "segment.h"
+#include "bytecode.h"
 
-#define COMMANDARGS 2
-#define FILEINDEX 1
 #define COLOURMAX 256
-#define FILEBUFFER 50
 #define STARTNUM 30
-#define ERRORBUFFER 100
+#define ERRORBUFFER 200
+#define ERRORWORD 64
 #define RECTSIZE 20
 #define MILLISECONDDELAY 20
+#define SPEEDINSTANT 0
+#define SPEEDANIMATED 1
 #define ALPHANUM 26
-#define WHITESPACE "\n\f\r\t "
-#define OPCHARS "+-/*"
-#define DIGITS "0123456789"
-#define NUMCHARS "-.0123456789"
 #define FACENORTH 90
 #define DEGTORAD (M_PI / 180)
+#define MOTIONSQUARE 256
+#define MOTIONLIMIT 4503599627370496.0
+#define BATCHEXTENSION ".ttl"
+#define BATCHMAXWORKERS 64
+#define BATCHIMAGE ".png"
+#define OPCODECOUNT (OP_SET + 1)
+#define STATPHASES 5
+#define STATDONE -1
+#define DOHEADER 7
+#define STREAMTESTS 13
+#define PROFILEBAR 20
+#define PROFILECALIBRATE 1000
+#define LEXTESTLINES 300
+#define LEXTESTPART 1024
+#define LEXTESTTHREADS 8
+#define BENCHFILE "bench_input.ttl"
+#define BENCHSIZES 4
+#define BENCHPHASES 5
+#define BENCHWORK 20000
+#define BENCHMINSAMPLES 11
+#define BENCHMAXSAMPLES 101
+#define BENCHPERCENTILE 0.99
 #define STREQ(A, B) (strcmp(A, B) == 0)
 
 struct loop{
-   double to;
-   double from;
+   operand to;
+   operand from;
    int varIndex;
 };
 typedef struct loop loop;
@@ -38,55 +67,346 @@ struct turtle{
 };
 typedef struct turtle turtle;
 
-struct lexeme{
+/*How a run of FD, RT and LT moves a turtle that starts at the origin facing
+angle 0. Any turtle is moved by turning the offset by its angle first.*/
+struct motion{
+   double turn;
+   double x;
+   double y;
+};
+typedef struct motion motion;
+
+/*Settings taken from the command line. When image is set the program is drawn
+into a framebuffer of width by height pixels and written to that file instead
+of being shown in an SDL window. speed is the number of lines shown per frame,
+or SPEEDINSTANT to draw as fast as possible. optimise is cleared by -O0 to run
+the bytecode exactly as it was compiled. threads is the number of threads that
+draw the image, or 0 for one per processor. When batch is set every file or
+directory in inputs is rendered into an image in that directory by workers
+threads, or one per processor if workers is 0. stats prints where the time
+went once the program has run. profile names the file the source profile is
+written to. stream runs the program while it is being read, a top level
+instruction at a time, and a filename of - reads it from stdin.*/
+struct options{
+   char *filename;
+   char *image;
+   int width;
+   int height;
+   int speed;
+   bool optimise;
+   int threads;
+   char *batch;
+   int workers;
+   char **inputs;
+   int inputCount;
+   bool stats;
+   char *profile;
+   bool stream;
+   char *bench;
+};
+typedef struct options options;
+
+enum statphase {STAT_LEX, STAT_COMPILE, STAT_OPTIMISE, STAT_RUN, STAT_OUTPUT};
+typedef enum statphase statphase;
+
+/*Counters for --stats. wall and cpu hold the seconds spent in each phase.
+While the program runs visits counts, for each DO, how often the loop was
+entered and, for each LOOP, how often it jumped back. How often every other
+instruction ran follows from those, so nothing else is counted while the
+bytecode runs and a program without stats only pays for a NULL check at DO and
+LOOP. When profile is set counts and times are kept for every instruction.
+The time of a loop that runs without the VM is given to its DO.*/
+struct runstats{
+   double wall[STATPHASES];
+   double cpu[STATPHASES];
+   int phase;
+   double phaseWall;
+   clock_t phaseCpu;
+   double *visits;
+   double executed[OPCODECOUNT];
+   double iterations;
+   double segments;
+   bool profile;
+   double *counts;
+   double *times;
+};
+typedef struct runstats runstats;
+
+/*A program rendered in batch mode and what happened to it. message holds the
+error of a program that did not run.*/
+struct batchjob{
+   char *input;
+   char *output;
+   bool ok;
+   char *message;
+   double seconds;
+};
+typedef struct batchjob batchjob;
+
+/*The programs of a batch. Workers take the job numbered next until there are
+none left.*/
+struct batch{
+   batchjob *jobs;
+   int count;
+   int capacity;
+   int next;
+   options *opts;
+   pthread_mutex_t lock;
+};
+typedef struct batch batch;
+
+enum benchphase {PHASE_LEX, PHASE_LEXSERIAL, PHASE_VALIDATE, PHASE_INTERPRET,
+   PHASE_RENDER};
+typedef enum benchphase benchphase;
+
+/*The times of every sample of one phase at one input size, sorted once all
+the samples have been taken*/
+struct benchresult{
+   double *samples;
+   int count;
+   double median;
+   double tail;
+};
+typedef struct benchresult benchresult;
+
+/*Reads the words of a program from a file or pipe a piece at a time. buffer
+holds size bytes read from in, of which the first pos have been used. word
+holds the word being read, which may run across pieces. count is the number of
+words read so far.*/
+struct wordstream{
+   FILE *in;
+   char *buffer;
+   size_t size;
+   size_t pos;
    char *word;
-   int index;
-   struct lexeme *next;
-   struct lexeme *prev;
+   int length;
+   int capacity;
+   int count;
 };
-typedef struct lexeme lexeme;
-
-struct sequence{
-   lexeme *start;
-   lexeme *current;
+typedef struct wordstream wordstream;
+
+/*Lines waiting to be drawn in the SDL window. Connected lines are kept as a run
+of points so they can be drawn with a single SDL_RenderDrawLines call. drawn
+counts the lines added since the screen was last updated. colour is the
+palette entry the window draws in, or -1 before the first line.*/
+struct linebatch{
+   SDL_Point *points;
+   int count;
+   int capacity;
+   int perFrame;
+   int drawn;
+   int colour;
+   Uint32 lastPresent;
 };
-typedef struct sequence sequence;
+typedef struct linebatch linebatch;
 
 struct program{
    sequence *code;
    int length;
    bool valid;
    char *errMessage;
+   arena *mem;
+   source *src;
    turtle squirt;
    double vars[26];
-   stack *polish;
+   bytecode *exec;
    SDL_Simplewin *sw;
+   framebuffer *fb;
+   linebatch *lines;
+   segmentbuffer *segments;
+   long drawn;
+   runstats *stats;
+   wordstream *stream;
 };
 typedef struct program program;
 
 /*Reads a file and generates a sequence of words by delimiting the file at
-whitespace characters. These words are added to the returned program struct.*/
+whitespace characters. These words are added to the returned program struct and
+are views into the mapped file rather than copies. Quits if the file cannot be
+opened.*/
 program *readProgramFile(char *filename);
 
+/*Returns a program holding the words of a file like readProgramFile, or NULL
+if the file cannot be opened*/
+program *openProgramFile(char *filename);
+
+/*Renders every program named by the inputs of opts into its own image on a
+pool of worker threads and prints the status and time of each. Returns true
+if every program ran and its image was written.*/
+bool runBatch(options *opts);
+
+/*Adds a job for a .ttl file, or for every .ttl file in a directory, sorted by
+name*/
+void addBatchInput(batch *b, char *path);
+
+/*Adds a job that renders input into an image of the same name in the batch
+directory*/
+void addBatchJob(batch *b, char *input);
+
+/*Renders jobs until none are left. arg is the batch.*/
+void *batchWorker(void *arg);
+
+/*Compiles and runs the program of a job into a framebuffer of its own and
+writes the image. Every program has its own state, so jobs can run on any
+number of threads at once.*/
+void renderJob(batch *b, batchjob *job);
+
+/*Returns a copy of str allocated with smartCalloc*/
+char *copyString(char *str);
+
+/*Returns the wall clock time in seconds*/
+double wallClock(void);
+
+/*Ends the phase being timed, if any, and starts timing phase. STATDONE ends
+the last phase. Does nothing if s is NULL.*/
+void markPhase(runstats *s, int phase);
+
+/*Works out how often every instruction ran from the visits of each DO and
+LOOP, as described for runstats. When profiling, the time taken to read the
+clock is taken off the time of each instruction.*/
+void countExecuted(program *p);
+
+/*Prints the time of each phase, the instructions run, loop iterations,
+segments, the deepest POLISH expression and the memory used*/
+void printStats(program *p);
+
+/*Adds up the counts and times of the instructions compiled from each line of
+the source. Sets lines to the number of lines and returns the offset of the
+start of each line, with one more entry for the end of the source. counts and
+times are allocated with one entry per line.*/
+long *profileLines(program *p, int *lines, double **counts, double **times);
+
+/*Returns the line of the source that holds word*/
+int findLine(long *starts, int lines, long offset);
+
+/*Prints every line of the source with how often it ran, its time and a bar
+that shows its share of the run time. A line runs as often as the most run
+instruction compiled from it.*/
+void printProfile(program *p);
+
+/*Writes the counts and times of every line and instruction to filename as
+JSON. Returns false if the file cannot be written.*/
+bool writeProfile(program *p, char *filename);
+
+/*Returns the time taken by a call to wallClock, which the profile takes off
+every instruction it times*/
+double clockCost(void);
+
+/*Times each phase on generated programs of 100 to 100000 loops, prints the
+median and 99th percentile of each and writes them to json. Returns false if
+json cannot be written.*/
+bool runBenchmark(char *json);
+
+/*Writes a valid program of blocks loops, each of which moves, turns and sets
+a variable, to filename. Returns the number of words written.*/
+long writeProgram(char *filename, int blocks);
+
+/*Runs the program in filename into a framebuffer and returns it, holding the
+segment buffer of every line it drew*/
+program *recordProgram(char *filename);
+
+/*Times one sample of a phase on the program in filename. Lexing times
+readProgramFile, which lexes on every processor, and serial lexing times the
+same on one thread, so the two show the speedup of lexing in parallel.
+Validation times ruleMain with no window and interpretation times runProgram
+with nothing to draw on. Rendering times only rasterSegments drawing the
+recorded lines into a new framebuffer on one thread.*/
+double timePhase(char *filename, benchphase phase, program *recorded);
+
+/*Sorts the samples of a result and sets its median and 99th percentile*/
+void summarise(benchresult *r);
+
+/*Compares two doubles for qsort*/
+int compareTimes(const void *a, const void *b);
+
+/*Returns the number of samples to take for a program of blocks loops, so
+that every size takes a similar time*/
+int sampleCount(int blocks);
+
 /*Returns true if a program follows the rule for the <MAIN> grammar*/
 bool ruleMain(program *p);
 
-/*A recursive function that returns true if all instructions in a program
-follows the rules defined by <INSTRCTLST> and <INSTRUCTION> grammar*/
+/*Runs a program read from in while it is being read. Each top level
+instruction is compiled and run as soon as its last word has been read, and
+its words and bytecode are then released, so memory grows with the longest
+instruction rather than the file. Only motion loops are marked, since the
+other optimisations need the whole program. An error stops the program, but
+instructions before it have already been drawn. Lines queued in the framebuffer
+are drawn before it returns. Returns true if the program is valid.*/
+bool streamProgram(program *p, FILE *in);
+
+/*Reads the next word from the stream and adds a copy of it to the end of the
+program. Returns its position, or NOWORD at the end of the input.*/
+int streamWord(program *p, wordstream *ws);
+
+/*Returns the next byte of the stream, or EOF*/
+int streamChar(wordstream *ws);
+
+/*Reads words until the instruction that starts at the current word is
+complete and one more word follows it, or the input ends*/
+void readInstruction(program *p, wordstream *ws);
+
+/*Returns true if the words of s from position first to word, of which there
+are count, make up a whole instruction. depth counts the braces open in a DO.*/
+bool instructionEnds(sequence *s, int first, int word, int count, int *depth);
+
+/*Compiles the top level instruction at the current word, with the body of a
+DO, and leaves the current word on its last word*/
+bool ruleStreamInstruction(program *p);
+
+/*Releases the words and bytecode of the instruction that has run, keeping
+only the word after it, which becomes the current word. Words keep their
+numbers in error messages.*/
+void releaseWords(program *p);
+
+/*Returns true if all instructions up to the } that closes the current block
+follow the rules defined by <INSTRCTLST> and <INSTRUCTION> grammar. DO bodies
+are parsed in the same loop, so nesting uses the open loops of the bytecode
+rather than the C stack.*/
 bool ruleInstrctList(program *p);
 
 /*Returns true if an instruction follows <INSTRUCTION> grammar*/
 bool ruleInstruction(program *p);
 
 /*Returns true if the subsequent word for FD, RT, and LT instructions
-is a valid variable or number. Uses SDL to draw lines for FD. RT and LT update
-the angle of the turtle struct.*/
+is a valid variable or number. Emits the matching FD, RT or LT instruction.*/
 bool ruleTransform(program *p);
 
-/*Draws a line in SDL and updates the screen based on a given distance and the
-current coordinates of the turtle. Uses functions from neillsd2.*/
+/*Moves the turtle a given distance. When there is a backend to draw on, the
+line it leaves is added to the segment buffer of the program, and lines for
+the SDL window are handed over straight away so they are animated. A streamed
+program also hands its lines over whenever the buffer is full.*/
 void drawline(program *p, double distance);
 
+/*Hands the lines added to the segment buffer since the last call to the
+backend in use. Lines go into the framebuffer when there is one, otherwise they
+are batched for the SDL window in their palette colours. A streamed program
+then empties the buffer, so its memory does not grow with the file.*/
+void drawSegments(program *p);
+
+/*Returns an empty line batch that updates the screen after perFrame lines, or
+once per frame when perFrame is SPEEDINSTANT*/
+linebatch *createLineBatch(int perFrame);
+
+/*Adds a line to the batch of the program, starting a new run of points if it
+does not continue the last one. Updates the screen when a frame is complete.*/
+void batchSegment(program *p, int x0, int y0, int x1, int y1);
+
+/*Draws the batched runs of points with SDL_RenderDrawLines. The last point is
+kept so the next line can continue the run.*/
+void flushLines(program *p);
+
+/*Draws the batched lines and updates the screen. If wait is true this first
+waits until a frame has passed since the last update.*/
+void presentFrame(program *p, bool wait);
+
+/*Sets the colour of the following lines in the palette of the segment buffer,
+so every backend draws them in it*/
+void setDrawColour(program *p, int r, int g, int b);
+
+/*Frees memory allocated for a line batch*/
+void freeLineBatch(linebatch *b);
+
 /*Gets the new x coordinate for the turtle based on the given distance.*/
 double getNewX(double distance, turtle t);
 
@@ -97,38 +417,59 @@ double getNewY(double distance, turtle t);
 Rotates right if right is true, otherwise left.*/
 double getNewAngle(double oldAng, double rotation, bool right);
 
+/*Runs the motion loop whose DO is at index start, once its variable and limit
+are set, and returns the index after its LOOP. The amounts are read once and
+the body runs in a tight loop that moves and draws exactly as the VM would.
+When nothing is drawn and the loop runs MOTIONSQUARE times or more, the turtle
+is moved by the body raised to the loop count by squaring instead.*/
+int runMotionLoop(program *p, int start, double limit);
+
+/*Moves the turtle by the body of the motion loop at start repeated count
+times. moves holds the amounts of the body.*/
+void repeatMotion(program *p, int start, double count);
+
+/*Returns the motion of a followed by b*/
+motion composeMotion(motion a, motion b);
+
+/*Returns true if x is a whole number small enough that counting up to it one
+at a time is exact*/
+bool isExactCount(double x);
+
 /*Returns true if the DO instruction follows the correct grammar*/
 bool ruleDo(program *p);
 
 /*Returns true if the DO instruction has correct FROM and TO grammar. Updates
-the to and from variables of the loop stuct.*/
+the to and from operands of the loop stuct.*/
 bool ruleDoInfo(program *p, loop *doLoop);
 
 /*Returns true if the DO instruction has the correct FROM grammar. Updates the
-for variable of the loop struct.*/
+from operand of the loop struct.*/
 bool ruleDoFrom(program *p, loop *doLoop);
 
 /*Returns true if the DO instruction has the correct TO grammar. Updates the
-to variable of the loop struct.*/
+to operand of the loop struct.*/
 bool ruleDoTo(program *p, loop *doLoop);
 
-/*Returns true if the grammar of the DO loop is correct. Performs the actions
-in the loop a certain number of times. The specified variable is set to the FROM
-value and incremented by one. The loop repeats until the TO value is exceeded.*/
+/*Emits a DO instruction and opens its loop. The body is compiled by
+ruleInstrctList, which closes the loop at the matching }.*/
 bool ruleDoLoop(program *p, loop doLoop);
 
-/*Returns true if the SET instruction has the correct grammar. Updates the value
-of a given variable. All variables are initialised to 0 if not set here.*/
+/*Closes the innermost open loop with a LOOP instruction that jumps back to the
+start of its body*/
+void endDoLoop(program *p);
+
+/*Returns true if the SET instruction has the correct grammar. Emits the POLISH
+expression followed by a SET instruction for the given variable.*/
 bool ruleSet(program *p);
 
-/*A recursive function that returns true if a POLISH expression has the
-correct grammar. Adds numbers to a stack and operates on the top two stack
-doubles. The stack ADT by Neill Campbell is used for this, but uses doubles
-instead of ints.*/
+/*Returns true if a POLISH expression has the
+correct grammar. Emits a PUSH for each VARNUM and an arithmetic instruction
+for each OP. Each PUSH adds one to polishTop, which updates polishDepth.*/
 bool rulePolish(program *p);
 
-/*Returns true if the current word is a valid operator. Performs +, -, *, and /
-operations on the stack by popping the top two values and pushing the result.*/
+/*Returns true if the current word is a valid operator with two values in
+polishTop to operate on. Emits the instruction for +, -, *, or / and leaves
+one value in their place.*/
 bool ruleOp(program *p);
 
 /*Returns true if the current word meets the criteria for <VARNUM> grammar*/
@@ -143,6 +484,25 @@ bool ruleVar(program *p);
 /*Converts the current word from a string to a double.*/
 double getValue(program *p);
 
+/*Resolves the current word into an operand. Variables are looked up when the
+operand is evaluated rather than when it is compiled.*/
+operand getOperand(program *p);
+
+/*Returns the current value of an operand*/
+double getOperandValue(program *p, operand arg);
+
+/*Appends an instruction to the program bytecode and returns its index. The
+source word of the instruction is the current word.*/
+int emitInstruction(program *p, opcode op);
+
+/*Executes the compiled bytecode of a valid program. POLISH expressions were
+checked when they were compiled, so they are evaluated on an array that is
+allocated once and sized to the deepest expression. The lines it adds to the
+segment buffer are drawn into the framebuffer before it returns. A program
+being profiled has every instruction timed into its stats, and the clock is
+only read when it is.*/
+bool runProgram(program *p);
+
 /*Only returns false. Stops file reading and sets the error message in a
 program struct when grammar rules aren't met.*/
 bool setProgError(program *p, char *message);
@@ -153,15 +513,12 @@ int getAlphaIndex(char c);
 /*Returns an initialised program struct that contains a sequence of words*/
 program *createProgram();
 
-/*Returns a sequence struct that will hold a doubly linked list of words*/
+/*Returns an empty sequence of words with no current word*/
 sequence *createSequence();
 
-/*Returns a lexeme struct that that will hold a word from a file*/
-lexeme *createLexeme(char *word);
-
-/*Returns true when the word is added to the program. This increases the
-program's length variable and updates the index of the current word.*/
-bool addLexeme(program *p, lexeme *word);
+/*Returns true when a copy of word is added to the end of the program. This
+increases the program's length variable and makes the word the current one.*/
+bool addLexeme(program *p, char *word);
 
 /*Used to calloc space and check for failed memory allocation. If allocation
 fails, the program quits.*/
@@ -170,14 +527,20 @@ void *smartCalloc(int quantity, int size);
 /*Quits the program and prints the specified message to stderr*/
 void errorQuit(char *message);
 
-/*Frees memory allocated for a program structure*/
+/*Frees memory allocated for a program structure. The error message is
+released with the arena of the program and the words with its sequence.*/
 void freeProgram(program *p);
 
 /*Frees memory allocated for a sequence structure*/
 void freeSequence(sequence *s);
 
-/*Frees memory allocated for a lexeme structure*/
-void freeLexeme(lexeme *lex);
+/*Fills in opts from the command line. Returns false if the arguments are not
+[-o image.ppm|image.png] [-s WIDTHxHEIGHT] [-p instant|animated|N] [-O0]
+[-t THREADS] [--stats] [--profile profile.json] [--stream] file.ttl|-
+or, to render many programs,
+-b OUTDIR [-j WORKERS] [-s WIDTHxHEIGHT] [-O0] [-t THREADS] file.ttl|dir ...
+or, to time each phase of the interpreter, -B bench.json*/
+bool parseOptions(int argc, char **argv, options *opts);
 
 /*Used to simulate program structures for realistic testing scenarios. Focuses
 on functionality of the parser.*/
@@ -186,140 +549,1131 @@ void testParse();
 /*Used to simulate program structures for realistic testing scenarios*/
 bool testProgram(char *progText, char *errorMessage);
 
+/*Returns a program containing the words of progText, split at whitespace*/
+program *createTestProgram(char *progText);
+
 /*Tests new functions added for the interpreter*/
 void testInterp();
 
 int main(int argc, char **argv) {
    program *p;
-   char *filename;
+   options opts;
    SDL_Simplewin sw;
+   runstats stats;
+   FILE *in = NULL;
+   int i;
    testParse();
    testInterp();
-   if (argc != COMMANDARGS){
+   if (parseOptions(argc, argv, &opts) == false){
       errorQuit("Wrong number of arguments...exiting.\n");
    }
-   Neill_SDL_Init(&sw);
-   filename = argv[FILEINDEX];
-   p = readProgramFile(filename);
-   p->sw = &sw;
-   Neill_SDL_SetDrawColour(&sw, COLOURMAX - 1, COLOURMAX - 1, COLOURMAX - 1);
-   ruleMain(p);
-   do{
-      Neill_SDL_Events(&sw);
-   } while (!sw.finished);
+   if (opts.bench != NULL){
+      free(opts.inputs);
+      if (runBenchmark(opts.bench) == false){
+         errorQuit("Could not write results...exiting\n");
+      }
+      return 0;
+   }
+   if (opts.batch != NULL){
+      i = runBatch(&opts) ? EXIT_SUCCESS : EXIT_FAILURE;
+      free(opts.inputs);
+      return i;
+   }
+   if (opts.image == NULL){
+      Neill_SDL_Init(&sw);
+   }
+   memset(&stats, 0, sizeof(runstats));
+   stats.phase = STATDONE;
+   markPhase(opts.stats ? &stats : NULL, STAT_LEX);
+   if (opts.stream == true){
+      p = createProgram();
+      in = STREQ(opts.filename, "-") ? stdin : fopen(opts.filename, "rb");
+      if (in == NULL){
+         printf("Could not open file...exiting\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   else{
+      p = readProgramFile(opts.filename);
+   }
+   if (opts.stats == true || opts.profile != NULL){
+      p->stats = &stats;
+      stats.profile = (opts.profile != NULL);
+   }
+   if (opts.image == NULL){
+      p->sw = &sw;
+      p->lines = createLineBatch(opts.speed);
+      setDrawColour(p, COLOURMAX - 1, COLOURMAX - 1, COLOURMAX - 1);
+   }
+   else{
+      p->fb = createFramebuffer(opts.width, opts.height, WWIDTH, WHEIGHT);
+      if (opts.threads > 0){
+         setRasterThreads(p->fb, opts.threads);
+      }
+   }
+   if (opts.stream == true){
+      markPhase(p->stats, STAT_RUN);
+      streamProgram(p, in);
+      if (in != stdin){
+         fclose(in);
+      }
+   }
+   else{
+      markPhase(p->stats, STAT_COMPILE);
+      if (ruleMain(p) == true){
+         markPhase(p->stats, STAT_OPTIMISE);
+         if (opts.optimise == true){
+            optimiseBytecode(p->exec);
+         }
+         markPhase(p->stats, STAT_RUN);
+         runProgram(p);
+      }
+   }
+   markPhase(p->stats, STAT_OUTPUT);
+   if (p->lines != NULL){
+      presentFrame(p, false);
+   }
+   if (p->fb != NULL){
+      if (writeImage(p->fb, opts.image) == 0){
+         errorQuit("Could not write image...exiting\n");
+      }
+   }
+   markPhase(p->stats, STATDONE);
+   if (opts.stats == true){
+      printStats(p);
+   }
+   if (opts.profile != NULL && stats.counts != NULL){
+      printProfile(p);
+      if (writeProfile(p, opts.profile) == false){
+         errorQuit("Could not write profile...exiting\n");
+      }
+   }
+   free(stats.counts);
+   free(stats.times);
+   if (p->fb == NULL){
+      do{
+         Neill_SDL_Events(&sw);
+      } while (!sw.finished);
+   }
    if (p->valid == false){
       printf("%s", p->errMessage);
    }
-   SDL_Quit();
-   atexit(SDL_Quit);
+   if (opts.image == NULL){
+      SDL_Quit();
+      atexit(SDL_Quit);
+   }
    freeProgram(p);
+   free(opts.inputs);
    return 0;
 }
 
+bool parseOptions(int argc, char **argv, options *opts){
+   int i;
+   char extra;
+   opts->filename = NULL;
+   opts->image = NULL;
+   opts->width = WWIDTH;
+   opts->height = WHEIGHT;
+   opts->speed = SPEEDANIMATED;
+   opts->optimise = true;
+   opts->threads = 0;
+   opts->batch = NULL;
+   opts->workers = 0;
+   opts->inputs = (char **)smartCalloc(argc, sizeof(char *));
+   opts->inputCount = 0;
+   opts->stats = false;
+   opts->profile = NULL;
+   opts->stream = false;
+   opts->bench = NULL;
+   for (i = 1; i < argc; i++){
+      if (STREQ(argv[i], "-o") && i + 1 < argc){
+         opts->image = argv[++i];
+      }
+      else if (STREQ(argv[i], "-s") && i + 1 < argc){
+         if (sscanf(argv[++i], "%dx%d%c", &opts->width, &opts->height,
+            &extra) != 2 || opts->width <= 0 || opts->height <= 0){
+            return false;
+         }
+      }
+      else if (STREQ(argv[i], "-O0")){
+         opts->optimise = false;
+      }
+      else if (STREQ(argv[i], "-t") && i + 1 < argc){
+         if (sscanf(argv[++i], "%d%c", &opts->threads, &extra) != 1
+            || opts->threads <= 0){
+            return false;
+         }
+      }
+      else if (STREQ(argv[i], "--stats")){
+         opts->stats = true;
+      }
+      else if (STREQ(argv[i], "--profile") && i + 1 < argc){
+         opts->profile = argv[++i];
+      }
+      else if (STREQ(argv[i], "--stream")){
+         opts->stream = true;
+      }
+      else if (STREQ(argv[i], "-B") && i + 1 < argc){
+         opts->bench = argv[++i];
+      }
+      else if (STREQ(argv[i], "-b") && i + 1 < argc){
+         opts->batch = argv[++i];
+      }
+      else if (STREQ(argv[i], "-j") && i + 1 < argc){
+         if (sscanf(argv[++i], "%d%c", &opts->workers, &extra) != 1
+            || opts->workers <= 0){
+            return false;
+         }
+      }
+      else if (STREQ(argv[i], "-p") && i + 1 < argc){
+         i++;
+         if (STREQ(argv[i], "instant")){
+            opts->speed = SPEEDINSTANT;
+         }
+         else if (STREQ(argv[i], "animated")){
+            opts->speed = SPEEDANIMATED;
+         }
+         else if (sscanf(argv[i], "%d%c", &opts->speed, &extra) != 1 ||
+            opts->speed <= 0){
+            return false;
+         }
+      }
+      else if (argv[i][0] != '-' || STREQ(argv[i], "-")){
+         opts->inputs[opts->inputCount++] = argv[i];
+      }
+      else{
+         return false;
+      }
+   }
+   if (opts->bench != NULL){
+      return opts->inputCount == 0 && opts->batch == NULL
+         && opts->image == NULL;
+   }
+   if (opts->batch != NULL){
+      return opts->inputCount > 0 && opts->image == NULL;
+   }
+   opts->filename = opts->inputs[0];
+   if (opts->stream == true && opts->profile != NULL){
+      return false;
+   }
+   return opts->inputCount == 1;
+}
+
 program *readProgramFile(char *filename){
-   char buffer[FILEBUFFER];
-   char *token;
-   FILE *fp;
    program *p;
-   p = createProgram();
-
-   if ((fp = fopen(filename, "r")) == NULL){
+   if ((p = openProgramFile(filename)) == NULL){
       printf("Could not open file...exiting\n");
       exit(EXIT_FAILURE);
    }
-   while (fgets(buffer, FILEBUFFER, fp) != NULL){
-      token = strtok(buffer, WHITESPACE);
-      while (token != NULL){
-         if (addLexeme(p, createLexeme(token)) == false){
-            errorQuit("Could not add word...exiting\n");
+   return p;
+}
+
+program *openProgramFile(char *filename){
+   program *p;
+   p = createProgram();
+   if ((p->src = openSource(filename)) == NULL){
+      freeProgram(p);
+      return NULL;
+   }
+   p->length = lexSource(p->src, p->code);
+   return p;
+}
+
+bool runBatch(options *opts){
+   pthread_t workers[BATCHMAXWORKERS];
+   batch b;
+   int i, count, started = 0, failed = 0;
+   double start;
+   b.jobs = NULL;
+   b.count = 0;
+   b.capacity = 0;
+   b.next = 0;
+   b.opts = opts;
+   if (pthread_mutex_init(&b.lock, NULL) != 0){
+      errorQuit("Could not start workers...exiting\n");
+   }
+   mkdir(opts->batch, 0777);
+   for (i = 0; i < opts->inputCount; i++){
+      addBatchInput(&b, opts->inputs[i]);
+   }
+   count = (opts->workers > 0) ? opts->workers
+      : (int)sysconf(_SC_NPROCESSORS_ONLN);
+   count = (count < 1) ? 1 : (count > BATCHMAXWORKERS) ? BATCHMAXWORKERS
+      : count;
+   start = wallClock();
+   for (i = 1; i < count && i < b.count; i++){
+      if (pthread_create(&workers[started], NULL, batchWorker, &b) == 0){
+         started++;
+      }
+   }
+   batchWorker(&b);
+   for (i = 0; i < started; i++){
+      pthread_join(workers[i], NULL);
+   }
+   for (i = 0; i < b.count; i++){
+      printf("%-6s %8.3fs  %s", b.jobs[i].ok ? "OK" : "FAILED",
+         b.jobs[i].seconds, b.jobs[i].input);
+      if (b.jobs[i].ok == true){
+         printf(" -> %s\n", b.jobs[i].output);
+      }
+      else{
+         printf("\n       %s", b.jobs[i].message);
+         failed++;
+      }
+      free(b.jobs[i].input);
+      free(b.jobs[i].output);
+      free(b.jobs[i].message);
+   }
+   printf("%d programs, %d failed, %d workers, %.3fs\n", b.count, failed,
+      started + 1, wallClock() - start);
+   pthread_mutex_destroy(&b.lock);
+   free(b.jobs);
+   return failed == 0;
+}
+
+void addBatchInput(batch *b, char *path){
+   struct stat info;
+   struct dirent *entry;
+   DIR *dir;
+   char *name;
+   int first, i, j, length, extension = strlen(BATCHEXTENSION);
+   batchjob swap;
+   if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)){
+      addBatchJob(b, path);
+      return;
+   }
+   if ((dir = opendir(path)) == NULL){
+      addBatchJob(b, path);
+      return;
+   }
+   first = b->count;
+   while ((entry = readdir(dir)) != NULL){
+      length = strlen(entry->d_name);
+      if (length > extension && STREQ(entry->d_name + length - extension,
+         BATCHEXTENSION)){
+         name = (char *)smartCalloc(strlen(path) + length + 2, sizeof(char));
+         sprintf(name, "%s/%s", path, entry->d_name);
+         addBatchJob(b, name);
+         free(name);
+      }
+   }
+   closedir(dir);
+   for (i = first + 1; i < b->count; i++){
+      swap = b->jobs[i];
+      for (j = i; j > first && strcmp(b->jobs[j - 1].input, swap.input) > 0;
+         j--){
+         b->jobs[j] = b->jobs[j - 1];
+      }
+      b->jobs[j] = swap;
+   }
+}
+
+void addBatchJob(batch *b, char *input){
+   batchjob *job;
+   char *name, *dot;
+   if (b->count == b->capacity){
+      b->capacity = (b->capacity == 0) ? STARTNUM : b->capacity * 2;
+      b->jobs = (batchjob *)realloc(b->jobs, b->capacity * sizeof(batchjob));
+      if (b->jobs == NULL){
+         errorQuit("Memory allocation failed...exiting\n");
+      }
+   }
+   job = &b->jobs[b->count++];
+   job->input = copyString(input);
+   job->ok = false;
+   job->message = NULL;
+   job->seconds = 0.0;
+   name = strrchr(input, '/');
+   name = (name == NULL) ? input : name + 1;
+   job->output = (char *)smartCalloc(strlen(b->opts->batch) + strlen(name)
+      + strlen(BATCHIMAGE) + 2, sizeof(char));
+   sprintf(job->output, "%s/%s", b->opts->batch, name);
+   dot = strrchr(job->output + strlen(b->opts->batch) + 1, '.');
+   strcpy((dot == NULL) ? job->output + strlen(job->output) : dot,
+      BATCHIMAGE);
+}
+
+void *batchWorker(void *arg){
+   batch *b = (batch *)arg;
+   int job;
+   for (;;){
+      pthread_mutex_lock(&b->lock);
+      job = b->next++;
+      pthread_mutex_unlock(&b->lock);
+      if (job >= b->count){
+         return NULL;
+      }
+      renderJob(b, &b->jobs[job]);
+   }
+}
+
+void renderJob(batch *b, batchjob *job){
+   program *p;
+   double start;
+   start = wallClock();
+   if ((p = openProgramFile(job->input)) == NULL){
+      job->message = copyString("Could not open file.\n");
+      job->seconds = wallClock() - start;
+      return;
+   }
+   p->fb = createFramebuffer(b->opts->width, b->opts->height, WWIDTH,
+      WHEIGHT);
+   setRasterThreads(p->fb, (b->opts->threads > 0) ? b->opts->threads : 1);
+   if (ruleMain(p) == true){
+      if (b->opts->optimise == true){
+         optimiseBytecode(p->exec);
+      }
+      runProgram(p);
+   }
+   if (p->valid == false){
+      job->message = copyString(p->errMessage);
+   }
+   else if (writeImage(p->fb, job->output) == 0){
+      job->message = copyString("Could not write image.\n");
+   }
+   else{
+      job->ok = true;
+   }
+   freeProgram(p);
+   job->seconds = wallClock() - start;
+}
+
+char *copyString(char *str){
+   char *copy;
+   copy = (char *)smartCalloc(strlen(str) + 1, sizeof(char));
+   strcpy(copy, str);
+   return copy;
+}
+
+double wallClock(void){
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void markPhase(runstats *s, int phase){
+   double now;
+   clock_t cpu;
+   if (s == NULL){
+      return;
+   }
+   now = wallClock();
+   cpu = clock();
+   if (s->phase != STATDONE){
+      s->wall[s->phase] += now - s->phaseWall;
+      s->cpu[s->phase] += (double)(cpu - s->phaseCpu) / CLOCKS_PER_SEC;
+   }
+   s->phase = phase;
+   s->phaseWall = now;
+   s->phaseCpu = cpu;
+}
+
+void countExecuted(program *p){
+   runstats *s = p->stats;
+   instruction *ins;
+   double *runs, cost = 0.0;
+   int pc, depth = 0;
+   runs = (double *)smartCalloc(p->exec->maxDepth + 1, sizeof(double));
+   runs[0] = 1.0;
+   if (s->profile == true){
+      free(s->counts);
+      s->counts = (double *)smartCalloc(p->exec->length + 1, sizeof(double));
+      cost = clockCost();
+   }
+   for (pc = 0; pc < p->exec->length; pc++){
+      ins = &p->exec->code[pc];
+      if (s->profile == true){
+         s->counts[pc] = runs[depth];
+         s->times[pc] -= cost * runs[depth];
+         s->times[pc] = (s->times[pc] < 0.0) ? 0.0 : s->times[pc];
+      }
+      if (ins->op == OP_LOOP){
+         s->executed[OP_LOOP] += runs[depth];
+         s->iterations += runs[depth--];
+      }
+      else{
+         s->executed[ins->op] += runs[depth];
+         if (ins->op == OP_FD){
+            s->segments += runs[depth];
+         }
+         if (ins->op == OP_DO){
+            runs[depth + 1] = s->visits[pc] + s->visits[ins->jump];
+            depth++;
          }
-         token = strtok(NULL, WHITESPACE);
       }
    }
-   fclose(fp);
-   return p;
+   free(runs);
+}
+
+void printStats(program *p){
+   static char *phases[STATPHASES] = {"lex", "compile", "optimise", "run",
+      "output"};
+   static char *ops[OPCODECOUNT] = {"FD", "RT", "LT", "DO", "LOOP", "PUSH",
+      "ADD", "SUB", "MUL", "DIV", "SET"};
+   runstats *s = p->stats;
+   struct rusage usage;
+   double wall = 0.0, cpu = 0.0;
+   int i;
+   fprintf(stderr, "%-12s %12s %12s\n", "phase", "wall ms", "cpu ms");
+   for (i = 0; i < STATPHASES; i++){
+      fprintf(stderr, "%-12s %12.3f %12.3f\n", phases[i], s->wall[i] * 1e3,
+         s->cpu[i] * 1e3);
+      wall += s->wall[i];
+      cpu += s->cpu[i];
+   }
+   fprintf(stderr, "%-12s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+   fprintf(stderr, "%-12s %12s\n", "instruction", "executed");
+   for (i = 0; i < OPCODECOUNT; i++){
+      fprintf(stderr, "%-12s %12.0f\n", ops[i], s->executed[i]);
+   }
+   fprintf(stderr, "%-20s %.0f\n", "DO iterations", s->iterations);
+   fprintf(stderr, "%-20s %.0f\n", "segments", s->segments);
+   fprintf(stderr, "%-20s %d\n", "POLISH depth", p->exec->polishDepth);
+   fprintf(stderr, "%-20s %ld words\n", "program", (long)p->length);
+   fprintf(stderr, "%-20s %lu bytes in %ld chunks\n", "arena",
+      (unsigned long)p->mem->bytes, p->mem->chunks);
+   if (getrusage(RUSAGE_SELF, &usage) == 0){
+      fprintf(stderr, "%-20s %ld KB\n", "peak memory", usage.ru_maxrss);
+   }
+}
+
+long *profileLines(program *p, int *lines, double **counts, double **times){
+   runstats *s = p->stats;
+   instruction *ins;
+   long *starts;
+   size_t i;
+   int pc, line;
+   *lines = 1;
+   for (i = 0; i < p->src->size; i++){
+      if (p->src->bytes[i] == '\n' && i + 1 < p->src->size){
+         (*lines)++;
+      }
+   }
+   starts = (long *)smartCalloc(*lines + 1, sizeof(long));
+   for (i = 0, line = 1; i < p->src->size; i++){
+      if (p->src->bytes[i] == '\n' && i + 1 < p->src->size){
+         starts[line++] = i + 1;
+      }
+   }
+   starts[*lines] = p->src->size;
+   *counts = (double *)smartCalloc(*lines, sizeof(double));
+   *times = (double *)smartCalloc(*lines, sizeof(double));
+   for (pc = 0; pc < p->exec->length; pc++){
+      ins = &p->exec->code[pc];
+      if (ins->source == 0){
+         continue;
+      }
+      line = findLine(starts, *lines, p->code->offsets[ins->source - 1]);
+      if (s->counts[pc] > (*counts)[line]){
+         (*counts)[line] = s->counts[pc];
+      }
+      (*times)[line] += s->times[pc];
+   }
+   return starts;
+}
+
+int findLine(long *starts, int lines, long offset){
+   int low = 0, high = lines - 1, middle;
+   while (low < high){
+      middle = (low + high + 1) / 2;
+      if (starts[middle] <= offset){
+         low = middle;
+      }
+      else{
+         high = middle - 1;
+      }
+   }
+   return low;
+}
+
+void printProfile(program *p){
+   long *starts;
+   double *counts, *times, total = 0.0;
+   int lines, line, bar, i, length;
+   starts = profileLines(p, &lines, &counts, &times);
+   for (line = 0; line < lines; line++){
+      total += times[line];
+   }
+   printf("%6s %12s %10s %6s  %-*s  %s\n", "line", "count", "ms", "time",
+      PROFILEBAR, "", "source");
+   for (line = 0; line < lines; line++){
+      length = (int)(starts[line + 1] - starts[line]);
+      while (length > 0 && strchr(WHITESPACE,
+         p->src->bytes[starts[line] + length - 1]) != NULL){
+         length--;
+      }
+      bar = (total > 0.0) ? (int)(times[line] / total * PROFILEBAR + 0.5) : 0;
+      if (counts[line] > 0.0){
+         printf("%6d %12.0f %10.3f %5.1f%%  ", line + 1, counts[line],
+            times[line] * 1e3, (total > 0.0) ? times[line] / total * 100.0
+            : 0.0);
+      }
+      else{
+         printf("%6d %12s %10s %6s  ", line + 1, "", "", "");
+      }
+      for (i = 0; i < PROFILEBAR; i++){
+         putchar(i < bar ? '#' : ' ');
+      }
+      printf("  %.*s\n", length, p->src->bytes + starts[line]);
+   }
+   free(starts);
+   free(counts);
+   free(times);
+}
+
+bool writeProfile(program *p, char *filename){
+   runstats *s = p->stats;
+   instruction *ins;
+   FILE *out;
+   long *starts;
+   double *counts, *times;
+   static char *ops[OPCODECOUNT] = {"FD", "RT", "LT", "DO", "LOOP", "PUSH",
+      "ADD", "SUB", "MUL", "DIV", "SET"};
+   int lines, line, pc, first = 1;
+   if ((out = fopen(filename, "w")) == NULL){
+      return false;
+   }
+   starts = profileLines(p, &lines, &counts, &times);
+   fprintf(out, "{\n  \"lines\": [");
+   for (line = 0; line < lines; line++){
+      if (counts[line] > 0.0){
+         fprintf(out, "%s\n    {\"line\": %d, \"count\": %.0f, "
+            "\"seconds\": %.9f}", first ? "" : ",", line + 1, counts[line],
+            times[line]);
+         first = 0;
+      }
+   }
+   fprintf(out, "\n  ],\n  \"instructions\": [");
+   for (pc = 0; pc < p->exec->length; pc++){
+      ins = &p->exec->code[pc];
+      fprintf(out, "%s\n    {\"index\": %d, \"op\": \"%s\", ",
+         (pc == 0) ? "" : ",", pc, ops[ins->op]);
+      if (ins->source != 0){
+         line = findLine(starts, lines, p->code->offsets[ins->source - 1]);
+         fprintf(out, "\"word\": %d, \"line\": %d, ", ins->source,
+            line + 1);
+      }
+      fprintf(out, "\"count\": %.0f, \"seconds\": %.9f}", s->counts[pc],
+         s->times[pc]);
+   }
+   fprintf(out, "\n  ]\n}\n");
+   free(starts);
+   free(counts);
+   free(times);
+   return fclose(out) == 0;
+}
+
+double clockCost(void){
+   double start;
+   int i;
+   start = wallClock();
+   for (i = 0; i < PROFILECALIBRATE; i++){
+      wallClock();
+   }
+   return (wallClock() - start) / (PROFILECALIBRATE + 1);
+}
+
+bool runBenchmark(char *json){
+   static char *names[BENCHPHASES] = {"lex", "lex-serial", "validate",
+      "interpret", "render"};
+   int sizes[BENCHSIZES] = {100, 1000, 10000, 100000};
+   benchresult results[BENCHSIZES][BENCHPHASES];
+   long words[BENCHSIZES];
+   program *recorded;
+   FILE *out;
+   int s, phase, i;
+   if ((out = fopen(json, "w")) == NULL){
+      return false;
+   }
+   printf("%-8s %-10s %-10s %7s %12s %12s\n", "blocks", "words", "phase",
+      "samples", "median ms", "p99 ms");
+   for (s = 0; s < BENCHSIZES; s++){
+      words[s] = writeProgram(BENCHFILE, sizes[s]);
+      recorded = recordProgram(BENCHFILE);
+      for (phase = 0; phase < BENCHPHASES; phase++){
+         results[s][phase].count = sampleCount(sizes[s]);
+         results[s][phase].samples = (double *)smartCalloc(
+            results[s][phase].count, sizeof(double));
+         for (i = 0; i < results[s][phase].count; i++){
+            results[s][phase].samples[i] = timePhase(BENCHFILE,
+               (benchphase)phase, recorded);
+         }
+         summarise(&results[s][phase]);
+         printf("%-8d %-10ld %-10s %7d %12.3f %12.3f\n", sizes[s], words[s],
+            names[phase], results[s][phase].count,
+            results[s][phase].median * 1e3, results[s][phase].tail * 1e3);
+      }
+      freeProgram(recorded);
+   }
+   remove(BENCHFILE);
+   fprintf(out, "{\n  \"unit\": \"seconds\",\n  \"results\": [\n");
+   for (s = 0; s < BENCHSIZES; s++){
+      for (phase = 0; phase < BENCHPHASES; phase++){
+         fprintf(out, "    {\"phase\": \"%s\", \"blocks\": %d, \"words\": %ld, "
+            "\"samples\": %d, \"median\": %.9f, \"p99\": %.9f}%s\n",
+            names[phase], sizes[s], words[s], results[s][phase].count,
+            results[s][phase].median, results[s][phase].tail,
+            (s == BENCHSIZES - 1 && phase == BENCHPHASES - 1) ? "" : ",");
+         free(results[s][phase].samples);
+      }
+   }
+   fprintf(out, "  ]\n}\n");
+   fclose(out);
+   printf("Results written to %s\n", json);
+   return true;
+}
+
+long writeProgram(char *filename, int blocks){
+   FILE *out;
+   int i;
+   if ((out = fopen(filename, "w")) == NULL){
+      errorQuit("Could not write benchmark program...exiting\n");
+   }
+   fprintf(out, "{\n");
+   for (i = 0; i < blocks; i++){
+      fprintf(out, "   DO A FROM 1 TO 10 {\n      FD A\n      RT %d\n"
+         "      SET B := A %d * ;\n      LT B\n   }\n", i % 89 + 1, i % 7 + 1);
+   }
+   fprintf(out, "}\n");
+   fclose(out);
+   return 2 + blocks * 21L;
+}
+
+program *recordProgram(char *filename){
+   program *p;
+   p = readProgramFile(filename);
+   p->fb = createFramebuffer(WWIDTH, WHEIGHT, WWIDTH, WHEIGHT);
+   setRasterThreads(p->fb, 1);
+   if (ruleMain(p) == false){
+      errorQuit("Benchmark program is not valid...exiting\n");
+   }
+   optimiseBytecode(p->exec);
+   runProgram(p);
+   return p;
+}
+
+double timePhase(char *filename, benchphase phase, program *recorded){
+   program *p;
+   framebuffer *fb;
+   double start, seconds;
+   if (phase == PHASE_RENDER){
+      fb = createFramebuffer(WWIDTH, WHEIGHT, WWIDTH, WHEIGHT);
+      setRasterThreads(fb, 1);
+      start = wallClock();
+      rasterSegments(fb, recorded->segments, 0, recorded->segments->count);
+      seconds = wallClock() - start;
+      freeFramebuffer(fb);
+      return seconds;
+   }
+   start = wallClock();
+   if (phase == PHASE_LEXSERIAL){
+      p = createProgram();
+      if ((p->src = openSource(filename)) == NULL){
+         errorQuit("Could not open benchmark program...exiting\n");
+      }
+      p->length = lexSourceThreads(p->src, p->code, 1, LEXMINPART);
+      seconds = wallClock() - start;
+      freeProgram(p);
+      return seconds;
+   }
+   p = readProgramFile(filename);
+   if (phase == PHASE_LEX){
+      seconds = wallClock() - start;
+      freeProgram(p);
+      return seconds;
+   }
+   start = wallClock();
+   if (ruleMain(p) == false){
+      errorQuit("Benchmark program is not valid...exiting\n");
+   }
+   if (phase == PHASE_VALIDATE){
+      seconds = wallClock() - start;
+      freeProgram(p);
+      return seconds;
+   }
+   optimiseBytecode(p->exec);
+   start = wallClock();
+   runProgram(p);
+   seconds = wallClock() - start;
+   freeProgram(p);
+   return seconds;
+}
+
+void summarise(benchresult *r){
+   int tail;
+   qsort(r->samples, r->count, sizeof(double), compareTimes);
+   r->median = r->samples[r->count / 2];
+   tail = (int)ceil(BENCHPERCENTILE * r->count) - 1;
+   r->tail = r->samples[(tail < 0) ? 0 : tail];
+}
+
+int compareTimes(const void *a, const void *b){
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+int sampleCount(int blocks){
+   int count = BENCHWORK / blocks;
+   if (count < BENCHMINSAMPLES){
+      return BENCHMINSAMPLES;
+   }
+   return (count > BENCHMAXSAMPLES) ? BENCHMAXSAMPLES : count;
+}
+
+bool ruleMain(program *p){
+   if (p->code->count == 0){
+      addLexeme(p, "");
+   }
+   p->code->current = 0;
+   if (p->code->kinds[p->code->current] != TK_LBRACE){
+      return setProgError(p, "Error: Program did not start with {.");
+   }
+   if (p->code->current + 1 >= p->code->count){
+      return setProgError(p, "Error: Program did not end with }.");
+   }
+   p->code->current++;
+   return ruleInstrctList(p);
+}
+
+bool ruleInstrctList(program *p){
+   int base = p->exec->depth;
+   while (true){
+      if (p->code->kinds[p->code->current] == TK_RBRACE){
+         if (p->exec->depth == base){
+            return p->valid;
+         }
+         endDoLoop(p);
+      }
+      else if (ruleInstruction(p) == false){
+         return p->valid;
+      }
+      if (p->code->current + 1 >= p->code->count){
+         return setProgError(p, "Error: Program did not end with }.");
+      }
+      p->code->current++;
+   }
+}
+
+bool ruleInstruction(program *p){
+   switch (p->code->kinds[p->code->current]){
+      case TK_FD:
+      case TK_RT:
+      case TK_LT:
+         return ruleTransform(p);
+      case TK_DO:
+         return ruleDo(p);
+      case TK_SET:
+         return ruleSet(p);
+      default:
+         return setProgError(p, "Error: No proper instruction found.");
+   }
+}
+
+bool streamProgram(program *p, FILE *in){
+   wordstream ws;
+   memset(&ws, 0, sizeof(wordstream));
+   ws.in = in;
+   ws.buffer = (char *)smartCalloc(READBUFFER, sizeof(char));
+   ws.capacity = STARTNUM;
+   ws.word = (char *)smartCalloc(ws.capacity, sizeof(char));
+   p->stream = &ws;
+   if (streamWord(p, &ws) == NOWORD){
+      addWord(p->code, "", 0);
+      p->length = 1;
+   }
+   p->code->current = 0;
+   if (p->code->kinds[p->code->current] != TK_LBRACE){
+      setProgError(p, "Error: Program did not start with {.");
+   }
+   else if (streamWord(p, &ws) == NOWORD){
+      setProgError(p, "Error: Program did not end with }.");
+   }
+   else{
+      p->code->current++;
+   }
+   while (p->valid == true && p->code->kinds[p->code->current] != TK_RBRACE){
+      readInstruction(p, &ws);
+      if (ruleStreamInstruction(p) == false){
+         break;
+      }
+      markMotionLoops(p->exec);
+      runProgram(p);
+      if (p->code->current + 1 >= p->code->count){
+         setProgError(p, "Error: Program did not end with }.");
+         break;
+      }
+      releaseWords(p);
+   }
+   p->stream = NULL;
+   free(ws.buffer);
+   free(ws.word);
+   if (p->fb != NULL){
+      flushSegments(p->fb);
+   }
+   return p->valid;
+}
+
+int streamWord(program *p, wordstream *ws){
+   int c;
+   ws->length = 0;
+   do{
+      c = streamChar(ws);
+   } while (c != EOF && c != '\0' && strchr(WHITESPACE, c) != NULL);
+   while (c != EOF && (c == '\0' || strchr(WHITESPACE, c) == NULL)){
+      if (ws->length + 1 >= ws->capacity){
+         ws->capacity *= 2;
+         ws->word = (char *)realloc(ws->word, ws->capacity);
+         if (ws->word == NULL){
+            errorQuit("Memory allocation failed...exiting\n");
+         }
+      }
+      ws->word[ws->length++] = c;
+      c = streamChar(ws);
+   }
+   if (ws->length == 0){
+      return NOWORD;
+   }
+   p->length = ++ws->count;
+   return addWord(p->code, ws->word, ws->length);
+}
+
+int streamChar(wordstream *ws){
+   if (ws->pos == ws->size){
+      ws->size = fread(ws->buffer, 1, READBUFFER, ws->in);
+      ws->pos = 0;
+      if (ws->size == 0){
+         return EOF;
+      }
+   }
+   return (unsigned char)ws->buffer[ws->pos++];
+}
+
+void readInstruction(program *p, wordstream *ws){
+   sequence *s = p->code;
+   int word = s->current, count = 1, depth = 0;
+   while (instructionEnds(s, s->current, word, count, &depth) == false){
+      if (word + 1 >= s->count && streamWord(p, ws) == NOWORD){
+         return;
+      }
+      word++;
+      count++;
+   }
+   if (word + 1 >= s->count){
+      streamWord(p, ws);
+   }
+}
+
+bool instructionEnds(sequence *s, int first, int word, int count, int *depth){
+   tokenkind kind = (tokenkind)s->kinds[word];
+   switch (s->kinds[first]){
+      case TK_FD:
+      case TK_RT:
+      case TK_LT:
+         return count >= 2;
+      case TK_SET:
+         if (count <= 2){
+            return false;
+         }
+         return kind != TK_WORD && kind != TK_OP && kind != TK_VAR
+            && kind != TK_NUMBER && kind != TK_BADNUMBER && kind != TK_ASSIGN;
+      case TK_DO:
+         if (count < DOHEADER){
+            return false;
+         }
+         if (count == DOHEADER && kind != TK_LBRACE){
+            return true;
+         }
+         if (kind == TK_LBRACE){
+            (*depth)++;
+         }
+         else if (kind == TK_RBRACE){
+            (*depth)--;
+         }
+         return *depth == 0;
+      default:
+         return true;
+   }
+}
+
+bool ruleStreamInstruction(program *p){
+   while (true){
+      if (p->code->kinds[p->code->current] == TK_RBRACE){
+         endDoLoop(p);
+      }
+      else if (ruleInstruction(p) == false){
+         return p->valid;
+      }
+      if (p->exec->depth == 0){
+         return p->valid;
+      }
+      if (p->code->current + 1 >= p->code->count){
+         return setProgError(p, "Error: Program did not end with }.");
+      }
+      p->code->current++;
+   }
 }
 
-bool ruleMain(program *p){
-   p->code->current = p->code->start;
-   if (!STREQ(p->code->current->word,"{")){
-      return setProgError(p, "Error: Program did not start with {.");
+void releaseWords(program *p){
+   dropWords(p->code, p->code->current + 1);
+   resetArena(p->mem);
+   p->exec->length = 0;
+   p->code->current = 0;
+}
+
+bool ruleTransform(program *p){
+   opcode op;
+   int i;
+   switch (p->code->kinds[p->code->current]){
+      case TK_RT:
+         op = OP_RT;
+         break;
+      case TK_LT:
+         op = OP_LT;
+         break;
+      default:
+         op = OP_FD;
+         break;
+   }
+   if (p->code->current + 1 >= p->code->count){
+      return setProgError(p, "Error: No VARNUM found.");
    }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Program did not end with }.");
+   p->code->current++;
+   if (ruleVarnum(p) == false){
+      return p->valid;
    }
-   p->code->current = p->code->current->next;
-   return ruleInstrctList(p);
+   i = emitInstruction(p, op);
+   p->exec->code[i].arg = getOperand(p);
+   return p->valid;
 }
 
-bool ruleInstrctList(program *p){
-   if (STREQ(p->code->current->word,"}")){
-      return p->valid;
+void drawline(program *p, double distance){
+   double x, y, newX, newY;
+   x = p->squirt.xcoord;
+   y = p->squirt.ycoord;
+   newX = getNewX(distance, p->squirt);
+   newY = getNewY(distance, p->squirt);
+   if (p->fb != NULL || p->lines != NULL){
+      addSegment(p->segments, x, y, newX, newY);
+      if (p->lines != NULL || (p->stream != NULL
+         && p->segments->count == p->segments->capacity)){
+         drawSegments(p);
+      }
    }
-   if (ruleInstruction(p) == false){
-      return p->valid;
+   p->squirt.xcoord = newX;
+   p->squirt.ycoord = newY;
+}
+
+void drawSegments(program *p){
+   segmentbuffer *s = p->segments;
+   unsigned char *rgb;
+   long i;
+   if (p->fb != NULL){
+      rasterSegments(p->fb, s, p->drawn, s->count);
+   }
+   else if (p->lines != NULL){
+      for (i = p->drawn; i < s->count; i++){
+         if (s->colours[i] != p->lines->colour){
+            flushLines(p);
+            p->lines->colour = s->colours[i];
+            rgb = s->palette[s->colours[i]];
+            if (p->sw != NULL){
+               Neill_SDL_SetDrawColour(p->sw, rgb[0], rgb[1], rgb[2]);
+            }
+         }
+         batchSegment(p, (int)s->x0[i], (int)s->y0[i], (int)s->x1[i],
+            (int)s->y1[i]);
+      }
    }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Program did not end with }.");
+   if (p->stream != NULL){
+      s->count = 0;
    }
-   p->code->current = p->code->current->next;
-   return ruleInstrctList(p);
+   p->drawn = s->count;
 }
 
-bool ruleInstruction(program *p){
-   if (STREQ(p->code->current->word,"FD")){
-      return ruleTransform(p);
+linebatch *createLineBatch(int perFrame){
+   linebatch *b;
+   b = (linebatch *)smartCalloc(1, sizeof(linebatch));
+   b->capacity = STARTNUM;
+   b->points = (SDL_Point *)smartCalloc(b->capacity, sizeof(SDL_Point));
+   b->perFrame = perFrame;
+   b->colour = -1;
+   b->lastPresent = SDL_GetTicks();
+   return b;
+}
+
+void batchSegment(program *p, int x0, int y0, int x1, int y1){
+   linebatch *b = p->lines;
+   SDL_Point *last;
+   if (b->count > 0){
+      last = &b->points[b->count - 1];
+      if (last->x != x0 || last->y != y0){
+         flushLines(p);
+         b->count = 0;
+      }
    }
-   else if (STREQ(p->code->current->word,"RT")){
-      return ruleTransform(p);
+   if (b->count + 2 > b->capacity){
+      b->capacity *= 2;
+      b->points = (SDL_Point *)realloc(b->points,
+         b->capacity * sizeof(SDL_Point));
+      if (b->points == NULL){
+         errorQuit("Memory allocation failed...exiting\n");
+      }
    }
-   else if (STREQ(p->code->current->word,"LT")){
-      return ruleTransform(p);
+   if (b->count == 0){
+      b->points[b->count].x = x0;
+      b->points[b->count++].y = y0;
    }
-   else if (STREQ(p->code->current->word, "DO")){
-      return ruleDo(p);
+   b->points[b->count].x = x1;
+   b->points[b->count++].y = y1;
+   b->drawn++;
+   if (b->perFrame == SPEEDINSTANT){
+      if (SDL_GetTicks() - b->lastPresent >= MILLISECONDDELAY){
+         presentFrame(p, false);
+      }
    }
-   else if (STREQ(p->code->current->word, "SET")){
-      return ruleSet(p);
+   else if (b->drawn >= b->perFrame){
+      presentFrame(p, true);
    }
-   return setProgError(p, "Error: No proper instruction found.");
 }
 
-bool ruleTransform(program *p){
-   double value;
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: No VARNUM found.");
+void flushLines(program *p){
+   linebatch *b = p->lines;
+   if (b->count > 1 && p->sw != NULL){
+      SDL_RenderDrawLines(p->sw->renderer, b->points, b->count);
    }
-   p->code->current = p->code->current->next;
-   if (ruleVarnum(p) == false){
-      return p->valid;
+   if (b->count > 0){
+      b->points[0] = b->points[b->count - 1];
+      b->count = 1;
    }
-   value = getValue(p);
-   if (STREQ(p->code->current->prev->word,"FD")){
-      if (p->sw != NULL){
-         drawline(p, value);
+}
+
+void presentFrame(program *p, bool wait){
+   linebatch *b = p->lines;
+   Uint32 elapsed;
+   flushLines(p);
+   if (wait == true){
+      elapsed = SDL_GetTicks() - b->lastPresent;
+      if (elapsed < MILLISECONDDELAY){
+         SDL_Delay(MILLISECONDDELAY - elapsed);
       }
    }
-   else if (STREQ(p->code->current->prev->word,"RT")){
-      p->squirt.angle = getNewAngle(p->squirt.angle, value, true);
-   }
-   else if (STREQ(p->code->current->prev->word,"LT")){
-      p->squirt.angle = getNewAngle(p->squirt.angle, value, false);
+   if (p->sw != NULL){
+      Neill_SDL_UpdateScreen(p->sw);
    }
-   return p->valid;
+   b->lastPresent = SDL_GetTicks();
+   b->drawn = 0;
 }
 
-void drawline(program *p, double distance){
-   double x, y, newX, newY;
-   x = p->squirt.xcoord;
-   y = p->squirt.ycoord;
-   newX = getNewX(distance, p->squirt);
-   newY = getNewY(distance, p->squirt);
-   SDL_RenderDrawLine(p->sw->renderer, x, y, newX, newY);
-   SDL_Delay(MILLISECONDDELAY);
-   Neill_SDL_UpdateScreen(p->sw);
-   p->squirt.xcoord = newX;
-   p->squirt.ycoord = newY;
+void setDrawColour(program *p, int r, int g, int b){
+   setSegmentColour(p->segments, r, g, b);
+}
+
+void freeLineBatch(linebatch *b){
+   if (b == NULL){
+      return;
+   }
+   free(b->points);
+   free(b);
 }
 
 double getNewX(double distance, turtle t){
@@ -348,27 +1702,111 @@ double getNewAngle(double oldAng, double rotation, bool right){
    return newAng;
 }
 
+int runMotionLoop(program *p, int start, double limit){
+   instruction *body;
+   double *moves;
+   double v;
+   int i, length, var;
+   bool draws = false;
+   body = &p->exec->code[start + 1];
+   moves = p->exec->moves;
+   length = p->exec->code[start].jump - start - 1;
+   var = p->exec->code[start].varIndex;
+   for (i = 0; i < length; i++){
+      moves[i] = getOperandValue(p, body[i].arg);
+      if (body[i].op == OP_FD){
+         draws = true;
+      }
+      else{
+         moves[i] = moves[i] * DEGTORAD;
+         if (body[i].op == OP_RT){
+            moves[i] = -moves[i];
+         }
+      }
+   }
+   v = p->vars[var];
+   if ((draws == false || (p->fb == NULL && p->lines == NULL))
+      && isExactCount(v) && isExactCount(limit) && limit - v >= MOTIONSQUARE){
+      repeatMotion(p, start, limit - v + 1);
+      p->vars[var] = limit + 1;
+      return p->exec->code[start].jump + 1;
+   }
+   do{
+      for (i = 0; i < length; i++){
+         if (body[i].op == OP_FD){
+            drawline(p, moves[i]);
+         }
+         else{
+            p->squirt.angle = p->squirt.angle + moves[i];
+         }
+      }
+   } while (v++ < limit);
+   p->vars[var] = v;
+   return p->exec->code[start].jump + 1;
+}
+
+void repeatMotion(program *p, int start, double count){
+   motion step = {0.0, 0.0, 0.0}, total = {0.0, 0.0, 0.0};
+   double *moves;
+   double angle;
+   int i;
+   moves = p->exec->moves;
+   for (i = 0; i < p->exec->code[start].jump - start - 1; i++){
+      if (p->exec->code[start + 1 + i].op == OP_FD){
+         step.x = step.x + moves[i] * cos(step.turn);
+         step.y = step.y + moves[i] * sin(step.turn);
+      }
+      else{
+         step.turn = step.turn + moves[i];
+      }
+   }
+   while (count >= 1){
+      if (fmod(count, 2) >= 1){
+         total = composeMotion(total, step);
+      }
+      step = composeMotion(step, step);
+      count = floor(count / 2);
+   }
+   angle = p->squirt.angle;
+   p->squirt.xcoord = p->squirt.xcoord + cos(angle) * total.x
+      - sin(angle) * total.y;
+   p->squirt.ycoord = p->squirt.ycoord + sin(angle) * total.x
+      + cos(angle) * total.y;
+   p->squirt.angle = angle + total.turn;
+}
+
+motion composeMotion(motion a, motion b){
+   motion m;
+   m.turn = a.turn + b.turn;
+   m.x = a.x + cos(a.turn) * b.x - sin(a.turn) * b.y;
+   m.y = a.y + sin(a.turn) * b.x + cos(a.turn) * b.y;
+   return m;
+}
+
+bool isExactCount(double x){
+   return x >= -MOTIONLIMIT && x <= MOTIONLIMIT && floor(x) >= x;
+}
+
 bool ruleDo(program *p){
    loop doLoop;
-   if (p->code->current->next == NULL){
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Null DO instruction.");
    }
-   p->code->current = p->code->current->next;
+   p->code->current++;
    if (ruleVar(p) == false){
       return p->valid;
    }
-   doLoop.varIndex = getAlphaIndex(p->code->current->word[0]);
+   doLoop.varIndex = getAlphaIndex(wordText(p->code, p->code->current)[0]);
    if (ruleDoInfo(p, &doLoop) == false){
       return p->valid;
    }
-   if (p->code->current->next == NULL){
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Expected { in DO instruction.");
    }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word,"{")){
+   p->code->current++;
+   if (p->code->kinds[p->code->current] != TK_LBRACE){
       return setProgError(p, "Error: Expected { in DO instruction.");
    }
-   p->code->current = p->code->current->next;
    return ruleDoLoop(p, doLoop);
 }
 
@@ -383,206 +1821,323 @@ bool ruleDoInfo(program *p, loop *doLoop){
 }
 
 bool ruleDoFrom(program *p, loop *doLoop){
-   if (p->code->current->next == NULL){
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Expected FROM in DO instruction.");
    }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word, "FROM")){
+   p->code->current++;
+   if (p->code->kinds[p->code->current] != TK_FROM){
       return setProgError(p, "Error: Expected FROM in DO instruction.");
    }
-   if (p->code->current->next == NULL){
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Expected VARNUM in DO instruction.");
    }
-   p->code->current = p->code->current->next;
+   p->code->current++;
    if (ruleVarnum(p) == false){
       return p->valid;
    }
-   doLoop->from = getValue(p);
-   p->vars[doLoop->varIndex] = doLoop->from;
+   doLoop->from = getOperand(p);
    return p->valid;
 }
 
 bool ruleDoTo(program *p, loop *doLoop){
-   if (p->code->current->next == NULL){
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Expected TO in DO instruction.");
    }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word, "TO")){
+   p->code->current++;
+   if (p->code->kinds[p->code->current] != TK_TO){
       return setProgError(p, "Error: Expected TO in DO instruction.");
    }
-   if (p->code->current->next == NULL){
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Expected VARNUM in DO instruction.");
    }
-   p->code->current = p->code->current->next;
+   p->code->current++;
    if (ruleVarnum(p) == false){
       return p->valid;
    }
-   doLoop->to = getValue(p);
+   doLoop->to = getOperand(p);
    return p->valid;
 }
 
 bool ruleDoLoop(program *p, loop doLoop){
-   lexeme *word;
-   word = p->code->current;
-   do{
-      p->code->current = word;
-      if (ruleInstrctList(p) == false){
-         return p->valid;
-      }
-   } while(p->vars[doLoop.varIndex]++ < doLoop.to);
+   int start;
+   bytecode *b = p->exec;
+   start = emitInstruction(p, OP_DO);
+   b->code[start].arg = doLoop.from;
+   b->code[start].limit = doLoop.to;
+   b->code[start].varIndex = doLoop.varIndex;
+   openLoop(b, start);
    return p->valid;
 }
 
+void endDoLoop(program *p){
+   int start, end;
+   bytecode *b = p->exec;
+   start = b->loops[--b->depth];
+   end = emitInstruction(p, OP_LOOP);
+   b->code[end].varIndex = b->code[start].varIndex;
+   b->code[end].depth = b->code[start].depth;
+   b->code[end].jump = start + 1;
+   b->code[start].jump = end;
+}
+
 bool ruleSet(program *p){
-   int alphaIndex;
-   double result;
-   if (p->code->current->next == NULL){
+   int alphaIndex, i;
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Null SET instruction.");
    }
-   p->code->current = p->code->current->next;
+   p->code->current++;
    if (ruleVar(p) == false){
       return p->valid;
    }
-   alphaIndex = getAlphaIndex(p->code->current->word[0]);
-   if (p->code->current->next == NULL){
+   alphaIndex = getAlphaIndex(wordText(p->code, p->code->current)[0]);
+   if (p->code->current + 1 >= p->code->count){
       return setProgError(p, "Error: Expected := in SET instruction.");
    }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word, ":=")){
+   p->code->current++;
+   if (p->code->kinds[p->code->current] != TK_ASSIGN){
       return setProgError(p, "Error: Expected := in SET instruction.");
    }
+   p->exec->polishTop = 0;
    if (rulePolish(p) == false){
       return p->valid;
    }
-   if (p->sw != NULL){
-      if (stack_pop(p->polish, &result) == false){
-         return setProgError(p, "Error: Attempted to use SET with null value.");
-      }
-      p->vars[alphaIndex] = result;
-      if (stack_peek(p->polish, &result) == true){
-         return setProgError(p, "Error: Incorrect POLISH notation.");
-      }
+   if (p->exec->polishTop == 0){
+      return setProgError(p, "Error: Attempted to use SET with null value.");
+   }
+   if (p->exec->polishTop > 1){
+      return setProgError(p, "Error: Incorrect POLISH notation.");
    }
+   i = emitInstruction(p, OP_SET);
+   p->exec->code[i].varIndex = alphaIndex;
    return p->valid;
 }
 
 bool rulePolish(program *p){
-   double value;
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Null POLISH instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (STREQ(p->code->current->word, ";")){
-      return p->valid;
-   }
-   if (strspn(p->code->current->word, OPCHARS) > 0){
-      if (ruleOp(p) == false){
+   int i;
+   while (true){
+      if (p->code->current + 1 >= p->code->count){
+         return setProgError(p, "Error: Null POLISH instruction.");
+      }
+      p->code->current++;
+      if (p->code->kinds[p->code->current] == TK_SEMICOLON){
          return p->valid;
       }
-      return rulePolish(p);
-   }
-   else if (ruleVarnum(p) == false){
-      return p->valid;
+      if (p->code->ops[p->code->current] != '\0'){
+         if (ruleOp(p) == false){
+            return p->valid;
+         }
+      }
+      else if (ruleVarnum(p) == false){
+         return p->valid;
+      }
+      else{
+         i = emitInstruction(p, OP_PUSH);
+         p->exec->code[i].arg = getOperand(p);
+         if (++p->exec->polishTop > p->exec->polishDepth){
+            p->exec->polishDepth = p->exec->polishTop;
+         }
+      }
    }
-   value = getValue(p);
-   stack_push(p->polish, value);
-   return rulePolish(p);
 }
 
 bool ruleOp(program *p){
-   double v1, v2;
-   if (strlen(p->code->current->word) > 1){
+   if (p->code->lengths[p->code->current] > 1){
       return setProgError(p, "Error: OP is more than one character.");
    }
-   if (p->sw != NULL){
-      if ((stack_pop(p->polish, &v2) == false)
-         || (stack_pop(p->polish, &v1) == false)){
-         return setProgError(p, "Error: OP operated on a non-existant number.");
-      }
-      switch(p->code->current->word[0]){
-         case '+':
-            stack_push(p->polish, (v1 + v2));
-            break;
-         case '-':
-            stack_push(p->polish, (v1 - v2));
-            break;
-         case '/':
-            stack_push(p->polish, (v1 / v2));
-            break;
-         case '*':
-            stack_push(p->polish, (v1 * v2));
-            stack_peek(p->polish, &v1);
-            break;
-         default:
-            return setProgError(p, "Error: OP used an invalid operator.");
-      }
-}
+   if (p->exec->polishTop < 2){
+      return setProgError(p, "Error: OP operated on a non-existant number.");
+   }
+   switch(p->code->ops[p->code->current]){
+      case '+':
+         emitInstruction(p, OP_ADD);
+         break;
+      case '-':
+         emitInstruction(p, OP_SUB);
+         break;
+      case '/':
+         emitInstruction(p, OP_DIV);
+         break;
+      case '*':
+         emitInstruction(p, OP_MUL);
+         break;
+      default:
+         return setProgError(p, "Error: OP used an invalid operator.");
+   }
+   p->exec->polishTop--;
    return p->valid;
 }
 
 bool ruleVarnum(program *p){
-   if (strspn(p->code->current->word, DIGITS)
-      == strlen(p->code->current->word)){
-      return p->valid;
-   }
-   if (strspn(p->code->current->word, NUMCHARS)
-      == strlen(p->code->current->word)){
-      if (charFrequency(p->code->current->word, '-') > 0){
-         if ((charFrequency(p->code->current->word, '-') > 1)
-            || (p->code->current->word[0] != '-')){
-            return setProgError(p, "Error: VARNUM contains invalid characters.");
-         }
-      }
-      if (charFrequency(p->code->current->word, '.') > 1){
+   switch (p->code->kinds[p->code->current]){
+      case TK_NUMBER:
+         return p->valid;
+      case TK_BADNUMBER:
          return setProgError(p, "Error: VARNUM contains invalid characters.");
-      }
-      return p->valid;
+      default:
+         return ruleVar(p);
    }
-   return ruleVar(p);
 }
 
 int charFrequency(char *str, char c){
-   int i = 0, count = 0;
-   while (i < (int) strlen(str)){
-      if (str[i] == c){
-         count++;
-      }
-      i++;
-   }
-   return count;
+   return countChar(str, strlen(str), c);
 }
 
 bool ruleVar(program *p){
-   char check;
-   if (strlen(p->code->current->word) > 1){
-      return setProgError(p,"Error: VAR is too many characters.");
+   if (p->code->kinds[p->code->current] == TK_VAR){
+      return p->valid;
    }
-   check = p->code->current->word[0];
-   if (isupper(check) == false || isalpha(check) == false){
-      return setProgError(p,"Error: VAR is an unexpected character.");
+   if (p->code->lengths[p->code->current] > 1){
+      return setProgError(p,"Error: VAR is too many characters.");
    }
-   return p->valid;
+   return setProgError(p,"Error: VAR is an unexpected character.");
 }
 
 double getValue(program *p){
    double value;
-   if (strspn(p->code->current->word, NUMCHARS)
-      == strlen(p->code->current->word)){
-      value = atof(p->code->current->word);
+   if (p->code->kinds[p->code->current] == TK_NUMBER){
+      value = wordValue(p->code, p->code->current);
    }
    else{
-      value = p->vars[getAlphaIndex(p->code->current->word[0])];
+      value = p->vars[getAlphaIndex(wordText(p->code, p->code->current)[0])];
    }
    return value;
 }
 
+operand getOperand(program *p){
+   operand arg;
+   arg.value = 0;
+   arg.varIndex = 0;
+   if (p->code->kinds[p->code->current] == TK_NUMBER){
+      arg.isVar = false;
+      arg.value = wordValue(p->code, p->code->current);
+   }
+   else{
+      arg.isVar = true;
+      arg.varIndex = getAlphaIndex(wordText(p->code, p->code->current)[0]);
+   }
+   return arg;
+}
+
+double getOperandValue(program *p, operand arg){
+   if (arg.isVar == true){
+      return p->vars[arg.varIndex];
+   }
+   return arg.value;
+}
+
+int emitInstruction(program *p, opcode op){
+   int i;
+   i = appendInstruction(p->exec, op);
+   p->exec->code[i].source = wordIndex(p->code, p->code->current);
+   return i;
+}
+
+bool runProgram(program *p){
+   instruction *ins;
+   double *limits, *polish, *visits = NULL, *times = NULL;
+   double from, now, then = 0.0;
+   int pc = 0, top = 0, last;
+   limits = (double *)smartCalloc(p->exec->maxDepth + 1, sizeof(double));
+   polish = (double *)smartCalloc(p->exec->polishDepth + 1, sizeof(double));
+   if (p->stats != NULL){
+      visits = (double *)smartCalloc(p->exec->length + 1, sizeof(double));
+      p->stats->visits = visits;
+      if (p->stats->profile == true){
+         free(p->stats->times);
+         times = (double *)smartCalloc(p->exec->length + 1, sizeof(double));
+         p->stats->times = times;
+         then = wallClock();
+      }
+   }
+   while (p->valid == true && pc < p->exec->length){
+      last = pc;
+      ins = &p->exec->code[pc++];
+      switch (ins->op){
+         case OP_FD:
+            drawline(p, getOperandValue(p, ins->arg));
+            break;
+         case OP_RT:
+            p->squirt.angle = getNewAngle(p->squirt.angle,
+               getOperandValue(p, ins->arg), true);
+            break;
+         case OP_LT:
+            p->squirt.angle = getNewAngle(p->squirt.angle,
+               getOperandValue(p, ins->arg), false);
+            break;
+         case OP_DO:
+            p->vars[ins->varIndex] = getOperandValue(p, ins->arg);
+            limits[ins->depth] = getOperandValue(p, ins->limit);
+            if (visits != NULL){
+               visits[pc - 1]++;
+            }
+            if (ins->motion == true){
+               from = p->vars[ins->varIndex];
+               pc = runMotionLoop(p, pc - 1, limits[ins->depth]);
+               if (visits != NULL){
+                  visits[ins->jump] += p->vars[ins->varIndex] - from - 1;
+               }
+            }
+            break;
+         case OP_LOOP:
+            if (p->vars[ins->varIndex]++ < limits[ins->depth]){
+               if (visits != NULL){
+                  visits[pc - 1]++;
+               }
+               pc = ins->jump;
+            }
+            break;
+         case OP_PUSH:
+            polish[top++] = getOperandValue(p, ins->arg);
+            break;
+         case OP_ADD:
+            top--;
+            polish[top - 1] = polish[top - 1] + polish[top];
+            break;
+         case OP_SUB:
+            top--;
+            polish[top - 1] = polish[top - 1] - polish[top];
+            break;
+         case OP_MUL:
+            top--;
+            polish[top - 1] = polish[top - 1] * polish[top];
+            break;
+         case OP_DIV:
+            top--;
+            polish[top - 1] = polish[top - 1] / polish[top];
+            break;
+         case OP_SET:
+            p->vars[ins->varIndex] = polish[--top];
+            break;
+      }
+      if (times != NULL){
+         now = wallClock();
+         times[last] += now - then;
+         then = now;
+      }
+   }
+   free(limits);
+   free(polish);
+   drawSegments(p);
+   if (p->fb != NULL && p->stream == NULL){
+      flushSegments(p->fb);
+   }
+   if (visits != NULL){
+      countExecuted(p);
+      p->stats->visits = NULL;
+      free(visits);
+   }
+   return p->valid;
+}
+
 bool setProgError(program *p, char *message){
    char fullError[ERRORBUFFER];
+   sequence *s = p->code;
+   int length = wordLength(s, s->current);
    p->valid = false;
-   sprintf(fullError,"%s Issue encountered at word %d: %s.\n",
-      message, p->code->current->index, p->code->current->word);
-   p->errMessage = (char *)smartCalloc(strlen(fullError) + 1,sizeof(char));
-   strcpy(p->errMessage,fullError);
+   sprintf(fullError,"%s Issue encountered at word %d: %.*s.\n",
+      message, wordIndex(s, s->current),
+      length < ERRORWORD ? length : ERRORWORD, wordText(s, s->current));
+   p->errMessage = arenaStrdup(p->mem, fullError);
    if (p->sw != NULL){
       p->sw->finished = 1;
    }
@@ -596,18 +2151,18 @@ int getAlphaIndex(char c){
 program *createProgram(){
    program *p;
    sequence *seq;
-   stack *s;
    int i;
    p = (program *)smartCalloc(1,sizeof(program));
    seq = createSequence();
-   s = stack_init();
    p->code = seq;
+   p->mem = createArena();
    p->length = 0;
    p->valid = true;
    p->squirt.xcoord = WWIDTH / 2;
    p->squirt.ycoord = WHEIGHT / 2;
    p->squirt.angle = FACENORTH * DEGTORAD;
-   p->polish = s;
+   p->exec = createBytecode();
+   p->segments = createSegments();
    /*initialise all vars to zero*/
    for (i = 0; i < ALPHANUM; i++){
       p->vars[i] = 0;
@@ -618,34 +2173,17 @@ program *createProgram(){
 sequence *createSequence(){
    sequence *s;
    s = (sequence *)smartCalloc(1, sizeof(sequence));
+   s->current = NOWORD;
    return s;
 }
 
-lexeme *createLexeme(char *word){
-   lexeme *lex;
-   lex = (lexeme *)smartCalloc(1,sizeof(lexeme));
-   lex->word = (char *)smartCalloc(strlen(word) + 1, sizeof(char));
-   lex->word = strcpy(lex->word,word);
-   return lex;
-}
-
-bool addLexeme(program *p, lexeme *word){
+bool addLexeme(program *p, char *word){
    if (p == NULL || word == NULL){
       return false;
    }
-   if (p->code->start == NULL){
-      p->code->start = word;
-      p->code->current = word;
-   }
-   else {
-      p->code->current->next = word;
-      word->prev = p->code->current;
-      p->code->current = word;
-
-   }
+   p->code->current = addWord(p->code, word, strlen(word));
    p->length++;
-   word->index = p->length;
-   return true;;
+   return true;
 }
 
 void *smartCalloc(int quantity, int size){
@@ -663,44 +2201,54 @@ void errorQuit(char *message){
 }
 
 void freeProgram(program *p){
-   if (p->valid == false){
-      free(p->errMessage);
-   }
    freeSequence(p->code);
-   stack_free(p->polish);
+   freeArena(p->mem);
+   closeSource(p->src);
+   freeBytecode(p->exec);
+   freeFramebuffer(p->fb);
+   freeLineBatch(p->lines);
+   freeSegments(p->segments);
    free(p);
 }
 
 void freeSequence(sequence *s){
-   lexeme *lex;
-   lex = s->start;
-   while(lex->next != NULL){
-      lex = lex->next;
-      freeLexeme(lex->prev);
-   }
-   freeLexeme(lex);
+   freeWords(s);
    free(s);
 }
 
-void freeLexeme(lexeme *lex){
-   free(lex->word);
-   free(lex);
-}
-
 void testInterp(){
-   program *p;
+   program *p, *q;
+   framebuffer *fb, *ref;
+   unsigned int black, white;
+   unsigned long seed;
+   int i, j, path, end[4], clip[4];
    double distance, x1, y1, angle;
+   static char *args[7] = {"interp", "-b", "out", "-j", "2", "a.ttl", "GFX"};
+   static char *benchArgs[4] = {"interp", "-B", "bench.json", "a.ttl"};
+   options opts;
+   batch runs;
+   runstats stats;
+   long *starts;
+   double *counts, *times;
+   FILE *in;
+   static char *streams[STREAMTESTS] = {"{ FD 30 RT 45 FD 20 }",
+      "{ SET X := 4 ; DO A FROM 1 TO X { DO B FROM 1 TO 5 { FD B RT 72 } "
+      "SET X := X 2 / ; LT A } FD X }",
+      "{ DO A FROM 1 TO 8 { FD 10 RT 45 } DO B FROM 3 TO 1 { FD B } }",
+      "{ DO A FROM 1 TO 3 FD 10 }", "{ DO A FROM 1 TO 3 { FD 10 RT 90 }",
+      "{ FD 10 DO A FRUM 1 TO 3 { FD 10 } }", "{ FD 10 SET A := 1 2 ; }",
+      "{ FD 10 SET A := 1 + ; }", "{ FD", "{ }", "", "FD 10", "{ } FD 10"};
    p = createProgram();
 
    /*Test getting new coordinates*/
-   addLexeme(p, createLexeme("30"));
+   addLexeme(p, "30");
    distance = getValue(p);
    assert(fabs(distance - 30.0) < 0.0001);
    assert(getAlphaIndex('A') == 0);
    assert(getAlphaIndex('B') == 1);
    assert(getAlphaIndex('Z') == 25);
    p->vars[0] = 20.0;
-   addLexeme(p, createLexeme("A"));
+   addLexeme(p, "A");
    distance = getValue(p);
    assert(fabs(distance - 20.0) < 0.0001);
    x1 = getNewX(distance, p->squirt);
@@ -724,19 +2272,543 @@ void testInterp(){
    assert(fabs(angle - 20.0) < 0.0001);
    angle = getNewAngle(p->squirt.angle, angle, true);
    assert(fabs(angle - (70 * DEGTORAD)) < 0.0001);
-   addLexeme(p, createLexeme("50"));
+   addLexeme(p, "50");
    p->squirt.angle = 70 * DEGTORAD;
    angle = getValue(p);
    angle = getNewAngle(p->squirt.angle, angle, false);
    assert(fabs(angle - (120 * DEGTORAD)) < 0.0001);
    freeProgram(p);
+
+   /*Test DO bodies are compiled once and run by the VM*/
+   p = createTestProgram("{ DO A FROM 1 TO 4 { RT 10 SET B := B 1 + ; } }");
+   assert(ruleMain(p) == true);
+   assert(p->exec->length == 7);
+   assert(p->exec->code[0].op == OP_DO);
+   assert(p->exec->code[0].jump == 6);
+   assert(p->exec->code[1].op == OP_RT);
+   assert(p->exec->code[4].op == OP_ADD);
+   assert(p->exec->code[5].op == OP_SET);
+   assert(p->exec->code[6].op == OP_LOOP);
+   assert(p->exec->code[6].jump == 1);
+   assert(p->exec->maxDepth == 1);
+   assert(runProgram(p) == true);
+   assert(fabs(p->vars[1] - 4.0) < 0.0001);
+   assert(fabs(p->vars[0] - 5.0) < 0.0001);
+   assert(fabs(p->squirt.angle - (50 * DEGTORAD)) < 0.0001);
+   freeProgram(p);
+   p = createTestProgram("{ DO A FROM 1 TO 3 { DO B FROM A TO 3 { "
+      "SET C := C 1 + ; } } }");
+   assert(ruleMain(p) == true);
+   assert(p->exec->maxDepth == 2);
+   assert(runProgram(p) == true);
+   assert(fabs(p->vars[2] - 6.0) < 0.0001);
+   freeProgram(p);
+   p = createTestProgram("{ DO A FROM 5 TO 1 { SET C := A ; } }");
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   assert(fabs(p->vars[2] - 5.0) < 0.0001);
+   assert(fabs(p->vars[0] - 6.0) < 0.0001);
+   freeProgram(p);
+   p = createTestProgram("{ SET A := 1 + ; }");
+   assert(ruleMain(p) == false);
+   assert(STREQ(p->errMessage, "Error: OP operated on a non-existant number. "
+      "Issue encountered at word 6: +.\n"));
+   freeProgram(p);
+   p = createTestProgram("{ SET A := 1 2 ; }");
+   assert(ruleMain(p) == false);
+   assert(STREQ(p->errMessage, "Error: Incorrect POLISH notation. "
+      "Issue encountered at word 7: ;.\n"));
+   freeProgram(p);
+   p = createTestProgram("{ SET Y := A B + - A - FD }");
+   assert(ruleMain(p) == false);
+   assert(STREQ(p->errMessage, "Error: OP operated on a non-existant number. "
+      "Issue encountered at word 8: -.\n"));
+   freeProgram(p);
+   p = createTestProgram("{ SET A := ; }");
+   assert(ruleMain(p) == false);
+   assert(STREQ(p->errMessage, "Error: Attempted to use SET with null value. "
+      "Issue encountered at word 5: ;.\n"));
+   freeProgram(p);
+   p = createTestProgram("{ SET A := 1 2 3 * + 4 - ; SET B := A 2 / ; }");
+   assert(ruleMain(p) == true);
+   assert(p->exec->polishDepth == 3);
+   assert(runProgram(p) == true);
+   assert(fabs(p->vars[0] - 3.0) < 0.0001);
+   assert(fabs(p->vars[1] - 1.5) < 0.0001);
+   freeProgram(p);
+
+   /*Test the software rasterizer*/
+   fb = createFramebuffer(10, 10, 10, 10);
+   black = packColour(0, 0, 0);
+   white = packColour(COLOURMAX - 1, COLOURMAX - 1, COLOURMAX - 1);
+   rasterLine(fb, 0, 0, 9, 3);
+   assert(fb->pixels[0] == white);
+   assert(fb->pixels[1] == white);
+   assert(fb->pixels[11] == black);
+   assert(fb->pixels[12] == white);
+   assert(fb->pixels[39] == white);
+   assert(fb->pixels[37] == black);
+   assert(fb->pixels[27] == white);
+   rasterLine(fb, -5, 14, 14, -5);
+   assert(fb->pixels[90] == white);
+   assert(fb->pixels[81] == white);
+   assert(fb->pixels[91] == black);
+   assert(fb->pixels[9] == white);
+   setRasterColour(fb, 1, 2, 3);
+   rasterLine(fb, 4, 4, 4, 4);
+   assert(fb->pixels[44] == packColour(1, 2, 3));
+   freeFramebuffer(fb);
+
+   /*Test every line path draws the same pixels as the reference*/
+   fb = createFramebuffer(97, 61, 97, 61);
+   ref = createFramebuffer(97, 61, 97, 61);
+   assert(setRasterPath(fb, RASTER_SCALAR) == 1);
+   for (path = RASTER_SCALAR; path <= RASTER_AVX2; path++){
+      if (setRasterPath(fb, (rasterpath)path) == 0){
+         continue;
+      }
+      seed = 1;
+      for (i = 0; i < 300; i++){
+         for (j = 0; j < 4; j++){
+            seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+            end[j] = clip[j] = (int)((seed >> 8) % 320) - 60;
+         }
+         /*Every fourth line lies inside the framebuffer*/
+         for (j = 0; j < 4 && i % 4 == 1; j++){
+            end[j] = clip[j] = (end[j] + 60) % 61;
+         }
+         if (i % 5 == 0){
+            end[3] = clip[3] = end[1];
+         }
+         if (i % 7 == 0){
+            end[2] = clip[2] = end[0];
+         }
+         /*Far lines are horizontal, vertical or diagonal, so the reference
+         can draw them from just off the edge*/
+         if (i % 11 == 0 && i % 3 == 0){
+            end[0] = -RASTERLIMIT;
+            clip[0] = -1;
+            end[1] = clip[1] = end[3];
+         }
+         else if (i % 11 == 0 && i % 3 == 1){
+            end[1] = -RASTERLIMIT;
+            clip[1] = -1;
+            end[0] = clip[0] = end[2];
+         }
+         else if (i % 11 == 0){
+            end[0] = -RASTERLIMIT;
+            end[1] = end[3] - end[2] - RASTERLIMIT;
+            clip[0] = -1;
+            clip[1] = end[3] - end[2] - 1;
+         }
+         setRasterColour(fb, i % COLOURMAX, i / COLOURMAX, path);
+         setRasterColour(ref, i % COLOURMAX, i / COLOURMAX, path);
+         rasterLine(fb, end[0], end[1], end[2], end[3]);
+         rasterLineReference(ref, clip[0], clip[1], clip[2], clip[3]);
+      }
+      assert(memcmp(fb->pixels, ref->pixels, 97 * 61 * sizeof(unsigned int))
+         == 0);
+   }
+   freeFramebuffer(fb);
+   freeFramebuffer(ref);
+
+   /*Test drawing queued lines on several threads matches drawing in order*/
+   fb = createFramebuffer(200, 150, 100, 75);
+   ref = createFramebuffer(200, 150, 100, 75);
+   assert(setRasterThreads(fb, 0) == 0);
+   assert(setRasterThreads(fb, 4) == 1 && fb->threads == 4);
+   assert(setRasterThreads(ref, 1) == 1);
+   seed = 7;
+   for (i = 0; i < 300; i++){
+      for (j = 0; j < 4; j++){
+         seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+         end[j] = (int)((seed >> 8) % 140) - 20;
+      }
+      if (i % 3 == 0){
+         setRasterColour(fb, i % COLOURMAX, 0, COLOURMAX - 1);
+         setRasterColour(ref, i % COLOURMAX, 0, COLOURMAX - 1);
+      }
+      rasterSegment(fb, end[0], end[1] * 0.75, end[2] + 0.5, end[3] * 0.75);
+      rasterSegment(ref, end[0], end[1] * 0.75, end[2] + 0.5, end[3] * 0.75);
+   }
+   assert(fb->queue != NULL && ref->queue == NULL);
+   flushSegments(fb);
+   assert(memcmp(fb->pixels, ref->pixels, 200 * 150 * sizeof(unsigned int))
+      == 0);
+   freeFramebuffer(fb);
+   freeFramebuffer(ref);
+   p = createTestProgram("{ FD 5 RT 90 FD 5 }");
+   p->fb = createFramebuffer(WWIDTH / 2, WHEIGHT / 2, WWIDTH, WHEIGHT);
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   assert(p->fb->pixels[(WHEIGHT / 4) * (WWIDTH / 2) + WWIDTH / 4] == white);
+   assert(p->fb->pixels[(WHEIGHT / 4 + 2) * (WWIDTH / 2) + WWIDTH / 4] == white);
+   assert(p->fb->pixels[(WHEIGHT / 4 + 2) * (WWIDTH / 2) + WWIDTH / 4 + 2]
+      == white);
+   assert(p->fb->pixels[(WHEIGHT / 4 + 3) * (WWIDTH / 2) + WWIDTH / 4] == black);
+   freeProgram(p);
+
+   /*Test batching lines into runs of points*/
+   p = createTestProgram("{ FD 5 RT 90 FD 5 }");
+   p->lines = createLineBatch(STARTNUM);
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   assert(p->lines->count == 3);
+   assert(p->lines->drawn == 2);
+   assert(p->lines->points[0].x == WWIDTH / 2);
+   assert(p->lines->points[0].y == WHEIGHT / 2);
+   batchSegment(p, 0, 0, 1, 1);
+   assert(p->lines->count == 2);
+   assert(p->lines->points[0].x == 0);
+   batchSegment(p, 1, 1, 2, 2);
+   assert(p->lines->count == 3);
+   presentFrame(p, false);
+   assert(p->lines->count == 1);
+   assert(p->lines->drawn == 0);
+   assert(p->lines->points[0].x == 2);
+   freeProgram(p);
+   p = createTestProgram("{ FD 5 FD 5 FD 5 }");
+   p->lines = createLineBatch(2);
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   assert(p->lines->drawn == 1);
+   assert(p->lines->count == 2);
+   freeProgram(p);
+
+   /*Test lines are kept in a segment buffer with a palette of their colours*/
+   p = createTestProgram("{ FD 5 RT 90 FD 5 }");
+   p->lines = createLineBatch(STARTNUM);
+   assert(p->segments->count == 0 && p->segments->paletteSize == 1);
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   assert(p->segments->count == 2 && p->drawn == 2);
+   assert(p->segments->colours[0] == 0 && p->lines->colour == 0);
+   assert(fabs(p->segments->x0[0] - WWIDTH / 2) < 0.0001);
+   assert(fabs(p->segments->y1[0] - (WHEIGHT / 2 + 5)) < 0.0001);
+   assert(fabs(p->segments->x1[1] - (WWIDTH / 2 + 5)) < 0.0001);
+   setDrawColour(p, 255, 0, 0);
+   drawline(p, 5);
+   setDrawColour(p, COLOURMAX - 1, COLOURMAX - 1, COLOURMAX - 1);
+   drawline(p, 5);
+   assert(p->segments->paletteSize == 2 && p->segments->colours[2] == 1);
+   assert(p->segments->colours[3] == 0 && p->lines->colour == 0);
+   assert(p->segments->palette[1][0] == 255 && p->segments->palette[1][1] == 0);
+   for (i = 2; i < PALETTESIZE; i++){
+      assert(setSegmentColour(p->segments, i, i, 0) == 1);
+   }
+   assert(setSegmentColour(p->segments, 1, 2, 3) == 0);
+   assert(p->segments->colour == PALETTESIZE - 1);
+   for (i = 0; i < SEGMENTSTART * 2; i++){
+      drawline(p, 1);
+   }
+   assert(p->segments->count == SEGMENTSTART * 2 + 4);
+   assert(p->drawn == p->segments->count);
+   assert(p->segments->colours[SEGMENTSTART * 2 + 3] == PALETTESIZE - 1);
+   freeProgram(p);
+
+   /*Test a segment buffer drawn at another size matches running the program
+   at that size*/
+   p = createTestProgram("{ DO A FROM 1 TO 40 { FD A RT 91 } }");
+   p->fb = createFramebuffer(WWIDTH / 4, WHEIGHT / 4, WWIDTH, WHEIGHT);
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   q = createTestProgram("{ DO A FROM 1 TO 40 { FD A RT 91 } }");
+   q->fb = createFramebuffer(WWIDTH / 2, WHEIGHT / 2, WWIDTH, WHEIGHT);
+   setRasterThreads(q->fb, 3);
+   assert(ruleMain(q) == true);
+   assert(runProgram(q) == true);
+   fb = createFramebuffer(WWIDTH / 2, WHEIGHT / 2, WWIDTH, WHEIGHT);
+   rasterSegments(fb, p->segments, 0, p->segments->count);
+   assert(p->segments->count == 40);
+   assert(memcmp(fb->pixels, q->fb->pixels, (WWIDTH / 2) * (WHEIGHT / 2)
+      * sizeof(unsigned int)) == 0);
+   freeFramebuffer(fb);
+   freeProgram(p);
+   freeProgram(q);
+
+   /*Test the optimiser keeps the drawing the same*/
+   p = createTestProgram("{ SET A := 2 3 * ; DO B FROM 1 TO 3 { "
+      "SET C := A 1 * ; SET D := 5 ; FD C RT B } }");
+   assert(ruleMain(p) == true);
+   optimiseBytecode(p->exec);
+   assert(p->exec->length == 4);
+   assert(p->exec->code[1].op == OP_FD);
+   assert(p->exec->code[1].arg.isVar == false);
+   assert(fabs(p->exec->code[1].arg.value - 6.0) < 0.0001);
+   assert(p->exec->code[3].op == OP_LOOP && p->exec->code[3].jump == 1);
+   assert(runProgram(p) == true);
+   x1 = p->squirt.xcoord;
+   y1 = p->squirt.ycoord;
+   freeProgram(p);
+   p = createTestProgram("{ SET A := 2 3 * ; DO B FROM 1 TO 3 { "
+      "SET C := A 1 * ; SET D := 5 ; FD C RT B } }");
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   assert(fabs(p->squirt.xcoord - x1) < 0.0001);
+   assert(fabs(p->squirt.ycoord - y1) < 0.0001);
+   freeProgram(p);
+   p = createTestProgram("{ FD A SET A := 5 ; FD A }");
+   assert(ruleMain(p) == true);
+   optimiseBytecode(p->exec);
+   assert(p->exec->length == 2);
+   assert(fabs(p->exec->code[0].arg.value) < 0.0001);
+   assert(fabs(p->exec->code[1].arg.value - 5.0) < 0.0001);
+   freeProgram(p);
+   p = createTestProgram("{ DO B FROM 1 TO 3 { FD C SET C := 5 ; "
+      "SET E := B 0 - ; FD E } }");
+   assert(ruleMain(p) == true);
+   optimiseBytecode(p->exec);
+   assert(p->exec->code[1].op == OP_FD && p->exec->code[1].arg.isVar == true);
+   assert(p->exec->code[4].op == OP_PUSH && p->exec->code[5].op == OP_SET);
+   assert(p->exec->length == 8);
+   freeProgram(p);
+   p = createTestProgram("{ DO B FROM 1 TO 3 { DO C FROM 1 TO 3 { "
+      "SET E := B 2 * ; FD E } } }");
+   assert(ruleMain(p) == true);
+   optimiseBytecode(p->exec);
+   assert(p->exec->code[1].op == OP_PUSH && p->exec->code[5].op == OP_DO);
+   assert(p->exec->code[7].jump == 6 && p->exec->code[8].jump == 1);
+   assert(p->exec->code[5].jump == 7 && p->exec->code[0].jump == 8);
+   assert(runProgram(p) == true);
+   freeProgram(p);
+
+   /*Test loops that only move the turtle*/
+   p = createTestProgram("{ SET D := 5 ; DO A FROM 1 TO 3 { FD D RT 90 } "
+      "DO B FROM 1 TO 3 { FD B } DO C FROM 1 TO 3 { SET D := 1 ; } }");
+   assert(ruleMain(p) == true);
+   markMotionLoops(p->exec);
+   assert(p->exec->code[2].op == OP_DO && p->exec->code[2].motion == true);
+   assert(p->exec->code[6].op == OP_DO && p->exec->code[6].motion == false);
+   assert(p->exec->code[9].op == OP_DO && p->exec->code[9].motion == false);
+   freeProgram(p);
+   p = createTestProgram("{ DO A FROM 1 TO 7.5 { FD 40 RT 37 LT 3.5 } FD 1 }");
+   p->fb = createFramebuffer(WWIDTH / 2, WHEIGHT / 2, WWIDTH, WHEIGHT);
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true);
+   x1 = p->squirt.xcoord;
+   y1 = p->squirt.ycoord;
+   angle = p->squirt.angle;
+   distance = p->vars[0];
+   fb = p->fb;
+   p->fb = NULL;
+   freeProgram(p);
+   p = createTestProgram("{ DO A FROM 1 TO 7.5 { FD 40 RT 37 LT 3.5 } FD 1 }");
+   p->fb = createFramebuffer(WWIDTH / 2, WHEIGHT / 2, WWIDTH, WHEIGHT);
+   assert(ruleMain(p) == true);
+   markMotionLoops(p->exec);
+   assert(p->exec->code[0].motion == true);
+   assert(runProgram(p) == true);
+   assert(memcmp(&x1, &p->squirt.xcoord, sizeof(double)) == 0);
+   assert(memcmp(&y1, &p->squirt.ycoord, sizeof(double)) == 0);
+   assert(memcmp(&angle, &p->squirt.angle, sizeof(double)) == 0);
+   assert(memcmp(&distance, &p->vars[0], sizeof(double)) == 0);
+   assert(memcmp(fb->pixels, p->fb->pixels, (WWIDTH / 2) * (WHEIGHT / 2)
+      * sizeof(unsigned int)) == 0);
+   freeFramebuffer(fb);
+   freeProgram(p);
+   p = createTestProgram("{ DO A FROM 1 TO 1000000000 { FD 1 RT 90 } "
+      "DO B FROM 1 TO 360000 { LT 1 } }");
+   assert(ruleMain(p) == true);
+   optimiseBytecode(p->exec);
+   assert(runProgram(p) == true);
+   assert(fabs(p->vars[0] - 1000000001.0) < 0.0001);
+   assert(fabs(p->vars[1] - 360001.0) < 0.0001);
+   assert(fabs(p->squirt.xcoord - WWIDTH / 2) < 0.0001);
+   assert(fabs(p->squirt.ycoord - WHEIGHT / 2) < 0.0001);
+   assert(fabs(sin(p->squirt.angle) - 1.0) < 0.0001);
+   freeProgram(p);
+
+   /*Test batch options, image names and a program that cannot be opened*/
+   assert(openProgramFile("no/such/file.ttl") == NULL);
+   assert(parseOptions(7, args, &opts) == true);
+   assert(opts.batch == args[2] && opts.workers == 2 && opts.inputCount == 2);
+   assert(opts.filename == NULL);
+   free(opts.inputs);
+   assert(parseOptions(2, args + 4, &opts) == true);
+   assert(opts.filename == args[5] && opts.batch == NULL);
+   free(opts.inputs);
+   assert(parseOptions(3, args + 4, &opts) == false);
+   free(opts.inputs);
+   assert(parseOptions(3, benchArgs, &opts) == true);
+   assert(opts.bench == benchArgs[2] && opts.filename == NULL);
+   free(opts.inputs);
+   assert(parseOptions(4, benchArgs, &opts) == false);
+   free(opts.inputs);
+   runs.jobs = NULL;
+   runs.count = 0;
+   runs.capacity = 0;
+   runs.next = 0;
+   runs.opts = &opts;
+   opts.batch = "out";
+   opts.width = WWIDTH / 2;
+   opts.height = WHEIGHT / 2;
+   opts.threads = 0;
+   opts.optimise = true;
+   for (i = 0; i < STARTNUM + 1; i++){
+      addBatchJob(&runs, "no/such/dir.x/file.ttl");
+   }
+   addBatchJob(&runs, "dir/name");
+   assert(runs.count == STARTNUM + 2);
+   assert(STREQ(runs.jobs[0].output, "out/file.png"));
+   assert(STREQ(runs.jobs[STARTNUM + 1].output, "out/name.png"));
+   assert(pthread_mutex_init(&runs.lock, NULL) == 0);
+   assert(batchWorker(&runs) == NULL && runs.next > runs.count);
+   for (i = 0; i < runs.count; i++){
+      assert(runs.jobs[i].ok == false && runs.jobs[i].message != NULL);
+      free(runs.jobs[i].input);
+      free(runs.jobs[i].output);
+      free(runs.jobs[i].message);
+   }
+   pthread_mutex_destroy(&runs.lock);
+   free(runs.jobs);
+
+   /*Test counting the instructions run from the visits of each loop*/
+   p = createTestProgram("{ DO A FROM 1 TO 5 { FD 1 DO B FROM 1 TO 3 "
+      "{ RT 1 } } SET C := 1 2 + ; DO D FROM 4 TO 1 { LT 1 } }");
+   memset(&stats, 0, sizeof(runstats));
+   p->stats = &stats;
+   assert(ruleMain(p) == true);
+   assert(runProgram(p) == true && stats.visits == NULL);
+   assert(fabs(stats.executed[OP_FD] - 5.0) < 0.0001);
+   assert(fabs(stats.executed[OP_RT] - 15.0) < 0.0001);
+   assert(fabs(stats.executed[OP_LT] - 1.0) < 0.0001);
+   assert(fabs(stats.executed[OP_DO] - 7.0) < 0.0001);
+   assert(fabs(stats.executed[OP_LOOP] - 21.0) < 0.0001);
+   assert(fabs(stats.executed[OP_PUSH] - 2.0) < 0.0001);
+   assert(fabs(stats.executed[OP_ADD] - 1.0) < 0.0001);
+   assert(fabs(stats.executed[OP_SET] - 1.0) < 0.0001);
+   assert(fabs(stats.iterations - 21.0) < 0.0001);
+   assert(fabs(stats.segments - 5.0) < 0.0001);
+   freeProgram(p);
+   p = createTestProgram("{ DO A FROM 1 TO 1000 { FD 1 RT 90 } "
+      "DO B FROM 1 TO 3 { DO C FROM 1 TO 10 { LT 5 } } }");
+   memset(&stats, 0, sizeof(runstats));
+   p->stats = &stats;
+   assert(ruleMain(p) == true);
+   optimiseBytecode(p->exec);
+   assert(p->exec->code[0].motion == true);
+   assert(runProgram(p) == true);
+   assert(fabs(stats.executed[OP_FD] - 1000.0) < 0.0001);
+   assert(fabs(stats.executed[OP_LT] - 30.0) < 0.0001);
+   assert(fabs(stats.iterations - 1033.0) < 0.0001);
+   assert(fabs(stats.segments - 1000.0) < 0.0001);
+   freeProgram(p);
+
+   /*Test a profiled run matches a plain one and counts every instruction*/
+   for (i = 0; i < 2; i++){
+      p = createTestProgram("{ SET X := 3 ;\nDO A FROM 1 TO 40 {\n"
+         "DO B FROM 1 TO X { FD A RT B }\n  SET Y := A 7 * B - ;\n"
+         "  DO C FROM 1 TO 300 { LT Y FD 2 } } }");
+      p->fb = createFramebuffer(WWIDTH / 4, WHEIGHT / 4, WWIDTH, WHEIGHT);
+      memset(&stats, 0, sizeof(runstats));
+      stats.profile = (i == 1);
+      p->stats = &stats;
+      assert(ruleMain(p) == true);
+      optimiseBytecode(p->exec);
+      assert(runProgram(p) == true);
+      if (i == 0){
+         fb = p->fb;
+         p->fb = NULL;
+         x1 = p->squirt.xcoord;
+         y1 = p->squirt.ycoord;
+         angle = p->squirt.angle;
+         distance = p->vars[getAlphaIndex('Y')];
+         freeProgram(p);
+         continue;
+      }
+      assert(memcmp(&x1, &p->squirt.xcoord, sizeof(double)) == 0);
+      assert(memcmp(&y1, &p->squirt.ycoord, sizeof(double)) == 0);
+      assert(memcmp(&angle, &p->squirt.angle, sizeof(double)) == 0);
+      assert(memcmp(&distance, &p->vars[getAlphaIndex('Y')], sizeof(double))
+         == 0);
+      assert(memcmp(fb->pixels, p->fb->pixels, (WWIDTH / 4) * (WHEIGHT / 4)
+         * sizeof(unsigned int)) == 0);
+      assert(fabs(stats.segments - (40 * 3 + 40 * 300)) < 0.0001);
+      for (j = 0; j < p->exec->length; j++){
+         assert(stats.times[j] >= 0.0);
+         if (p->exec->code[j].op == OP_FD){
+            assert(fabs(stats.counts[j] - 120.0) < 0.0001
+               || fabs(stats.counts[j] - 12000.0) < 0.0001);
+         }
+      }
+      starts = profileLines(p, &path, &counts, &times);
+      assert(path == 5 && starts[1] == 15);
+      assert(findLine(starts, path, 0) == 0 && findLine(starts, path, 15) == 1);
+      assert(fabs(counts[1] - 1.0) < 0.0001);
+      assert(fabs(counts[2] - 120.0) < 0.0001);
+      assert(fabs(counts[3] - 40.0) < 0.0001);
+      assert(fabs(counts[4] - 12000.0) < 0.0001);
+      free(starts);
+      free(counts);
+      free(times);
+      free(stats.counts);
+      free(stats.times);
+      freeFramebuffer(fb);
+      freeProgram(p);
+   }
+   stats.phase = STATDONE;
+   markPhase(&stats, STAT_RUN);
+   markPhase(&stats, STATDONE);
+   assert(stats.wall[STAT_RUN] >= 0.0 && stats.phase == STATDONE);
+   markPhase(NULL, STAT_RUN);
+
+   /*Test streaming a program gives the same drawing and errors as reading it
+   all first, and releases the words of each instruction once it has run*/
+   for (i = 0; i < STREAMTESTS; i++){
+      p = createTestProgram(streams[i]);
+      p->fb = createFramebuffer(WWIDTH / 4, WHEIGHT / 4, WWIDTH, WHEIGHT);
+      if (ruleMain(p) == true){
+         markMotionLoops(p->exec);
+         runProgram(p);
+      }
+      fb = p->fb;
+      p->fb = NULL;
+      q = p;
+      p = createProgram();
+      p->fb = createFramebuffer(WWIDTH / 4, WHEIGHT / 4, WWIDTH, WHEIGHT);
+      assert((in = tmpfile()) != NULL);
+      fputs(streams[i], in);
+      rewind(in);
+      assert(streamProgram(p, in) == q->valid);
+      fclose(in);
+      if (p->valid == true){
+         assert(memcmp(&q->squirt, &p->squirt,
+            sizeof(p->squirt)) == 0);
+         assert(memcmp(fb->pixels, p->fb->pixels, (WWIDTH / 4)
+            * (WHEIGHT / 4) * sizeof(unsigned int)) == 0);
+      }
+      else{
+         assert(STREQ(q->errMessage, p->errMessage));
+      }
+      assert(p->stream == NULL && p->mem->chunks <= 1);
+      freeFramebuffer(fb);
+      freeProgram(q);
+      freeProgram(p);
+   }
+   p = createProgram();
+   p->fb = createFramebuffer(WWIDTH / 4, WHEIGHT / 4, WWIDTH, WHEIGHT);
+   assert((in = tmpfile()) != NULL);
+   fputs("{", in);
+   for (i = 0; i < 3000; i++){
+      fprintf(in, " SET A := A 1 + ; DO B FROM 1 TO 2 { RT A } FD 1");
+   }
+   fputs(" DO C FROM 1 TO 3000 { FD 1 RT 1 } }", in);
+   rewind(in);
+   assert(streamProgram(p, in) == true);
+   fclose(in);
+   assert(fabs(p->vars[0] - 3000.0) < 0.0001 && p->length == 57014);
+   assert(p->code->count == 1 && p->code->first == 57013);
+   assert(p->code->capacity < 100 && p->mem->chunks <= 1);
+   assert(p->segments->count == 0 && p->segments->capacity <= SEGMENTSTART);
+   freeProgram(p);
 }
 
 void testParse(){
-   lexeme *lex0, *lex1, *lex2, *lex3, *lex4, *lex5, *lex6, *lex7, *lex8;
+   int lex0, lex1, lex2, lex3, lex4, lex5, lex6, lex7, lex8;
    sequence *seq1;
-   program *prog1;
-   char errorMessage[200], *callocTest;
+   program *prog1, *prog2;
+   char errorMessage[200], *callocTest, *text, *end;
+   int i, j;
 
    callocTest = smartCalloc(30, sizeof(char));
    assert(callocTest != NULL);
@@ -746,49 +2818,111 @@ void testParse(){
    assert(charFrequency("octopodes", 'o') == 3);
    assert(charFrequency("zack", 'h') == 0);
 
+   /*Test words are classified when they are created*/
+   prog1 = createProgram();
+   addLexeme(prog1, "FD");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_FD
+      && wordLength(prog1->code, lex1) == 2 && prog1->code->ops[lex1] == '\0');
+   addLexeme(prog1, ":=");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_ASSIGN);
+   addLexeme(prog1, "Q");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_VAR);
+   addLexeme(prog1, "-1.5");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_NUMBER
+      && prog1->code->ops[lex1] == '-');
+   addLexeme(prog1, "1-5");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_BADNUMBER);
+   addLexeme(prog1, "1.5.");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_BADNUMBER);
+   addLexeme(prog1, "-");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_NUMBER
+      && prog1->code->ops[lex1] == '-');
+   assert(wordValue(prog1->code, lex1) >= 0
+      && wordValue(prog1->code, lex1) <= 0);
+   addLexeme(prog1, "-12.25");
+   lex1 = prog1->code->current;
+   assert(wordValue(prog1->code, lex1) >= -12.25
+      && wordValue(prog1->code, lex1) <= -12.25);
+   addLexeme(prog1, "0.1");
+   lex1 = prog1->code->current;
+   assert(wordValue(prog1->code, lex1) >= 0.1
+      && wordValue(prog1->code, lex1) <= 0.1);
+   addLexeme(prog1, ".5");
+   lex1 = prog1->code->current;
+   assert(wordValue(prog1->code, lex1) >= 0.5
+      && wordValue(prog1->code, lex1) <= 0.5);
+   addLexeme(prog1, "1.");
+   lex1 = prog1->code->current;
+   assert(wordValue(prog1->code, lex1) >= 1
+      && wordValue(prog1->code, lex1) <= 1);
+   addLexeme(prog1, "0.1000000000000000055511151231257827");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_NUMBER);
+   assert(wordValue(prog1->code, lex1) >= 0.1
+      && wordValue(prog1->code, lex1) <= 0.1);
+   addLexeme(prog1, "123456789012345678901234567890");
+   lex1 = prog1->code->current;
+   assert(wordValue(prog1->code, lex1) >= 123456789012345678901234567890.0
+      && wordValue(prog1->code, lex1) <= 123456789012345678901234567890.0);
+   addLexeme(prog1, "1-a");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_WORD);
+   addLexeme(prog1, "*");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_OP && prog1->code->ops[lex1] == '*');
+   addLexeme(prog1, "++");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_WORD
+      && prog1->code->ops[lex1] == '+' && wordLength(prog1->code, lex1) == 2);
+   addLexeme(prog1, "FROMA");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_WORD);
+   freeProgram(prog1);
+
    /*struct create testing*/
-   lex1 = createLexeme("test");
    seq1 = createSequence();
    prog1 = createProgram();
-   assert(lex1 != NULL);
-   assert(STREQ(lex1->word, "test"));
-   assert(lex1->index == 0);
-   assert(lex1->next ==NULL);
-   assert(lex1->prev == NULL);
-   assert(seq1->start == NULL);
-   assert(seq1->current == NULL);
-   assert(prog1->code->start == NULL);
-   assert(prog1->code->current == NULL);
+   assert(seq1->count == 0);
+   assert(seq1->current == NOWORD);
+   assert(prog1->code->count == 0);
+   assert(prog1->code->current == NOWORD);
    assert(prog1->length == 0);
    assert(prog1->valid == true);
    assert(prog1->errMessage == NULL);
 
    /*test adding lexemes*/
-   assert(addLexeme(NULL,lex1) == false);
-   assert(addLexeme(prog1,NULL) == false);
-   assert(addLexeme(prog1,lex1) == true);
-   assert(STREQ(prog1->code->start->word,lex1->word));
-   assert(STREQ(prog1->code->current->word,lex1->word));
+   assert(addLexeme(NULL, "test") == false);
+   assert(addLexeme(prog1, NULL) == false);
+   assert(addLexeme(prog1, "test") == true);
+   lex1 = prog1->code->current;
+   assert(lex1 == 0);
+   assert(strncmp(wordText(prog1->code, lex1), "test", 4) == 0);
+   assert(wordLength(prog1->code, lex1) == 4);
    assert(prog1->length == 1);
-   assert(lex1->index == 1);
-   assert(prog1->code->start->index == prog1->length);
-   lex2 = createLexeme("test2");
-   assert(STREQ(prog1->code->start->word, lex1->word));
-   assert(addLexeme(prog1,lex2) == true);
-   assert(STREQ(prog1->code->current->word, lex2->word));
-   assert(STREQ(prog1->code->start->next->word, lex2->word));
-   assert(STREQ(prog1->code->current->prev->word, lex1->word));
+   assert(wordIndex(prog1->code, lex1) == 1);
+   assert(wordIndex(prog1->code, 0) == prog1->length);
+   assert(addLexeme(prog1, "test2") == true);
+   lex2 = prog1->code->current;
+   assert(lex2 == lex1 + 1 && prog1->code->count == 2);
+   assert(strncmp(wordText(prog1->code, lex2), "test2", 5) == 0);
+   assert(wordLength(prog1->code, lex2) == 5);
    assert(prog1->length == 2);
-   assert(lex2->index == 2);
-   assert(prog1->code->current->index == prog1->length);
+   assert(wordIndex(prog1->code, lex2) == 2);
+   assert(wordIndex(prog1->code, prog1->code->current) == prog1->length);
 
-   prog1->code->current = prog1->code->start;
+   prog1->code->current = 0;
    assert(setProgError(prog1,"test error") == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "test error Issue encountered at word 1: "
       "test.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
 
    /*Test '{' and '}' start and end conditions for parser*/
    assert(ruleMain(prog1) == false);
@@ -798,109 +2932,103 @@ void testParse(){
          "test.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   lex3 = createLexeme("{");
-   addLexeme(prog1, lex3);
+   addLexeme(prog1, "{");
+   lex3 = prog1->code->current;
    assert(ruleMain(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage,
          "Error: Program did not end with }. Issue encountered at word 1: "
          "{.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex5 = createLexeme("}");
-   addLexeme(prog1,lex5);
+   addLexeme(prog1, "}");
+   lex5 = prog1->code->current;
    assert(ruleInstrctList(prog1) == true);
    assert(ruleMain(prog1) == true);
 
    freeProgram(prog1);
    prog1 = createProgram();
-   lex1 = createLexeme("-1.3");
-   lex2 = createLexeme("1.3");
-   lex3 = createLexeme("-1");
-   lex4 = createLexeme("23");
-   lex5 = createLexeme("1");
-   lex6 = createLexeme("A");
-   lex7 = createLexeme("TEST");
-   lex8 = createLexeme("}");
    /*Test var and varnum*/
-   addLexeme(prog1,lex1);
+   addLexeme(prog1, "-1.3");
+   lex1 = prog1->code->current;
    assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1,lex2);
+   addLexeme(prog1, "1.3");
+   lex2 = prog1->code->current;
    assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1,lex3);
+   addLexeme(prog1, "-1");
+   lex3 = prog1->code->current;
    assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex4);
+   addLexeme(prog1, "23");
+   lex4 = prog1->code->current;
    assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex5);
+   addLexeme(prog1, "1");
+   lex5 = prog1->code->current;
    assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex6);
+   addLexeme(prog1, "A");
+   lex6 = prog1->code->current;
    assert(ruleVar(prog1) == true);
    assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex7);
+   addLexeme(prog1, "TEST");
+   lex7 = prog1->code->current;
    assert(ruleVar(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
       "Issue encountered at word 7: TEST.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
    assert(ruleVarnum(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
       "Issue encountered at word 7: TEST.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, lex8);
+   addLexeme(prog1, "}");
+   lex8 = prog1->code->current;
    assert(ruleVar(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is an unexpected character. "
       "Issue encountered at word 8: }.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
    assert(ruleVarnum(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is an unexpected character. "
       "Issue encountered at word 8: }.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
 
    freeProgram(prog1);
    prog1 = createProgram();
-   lex0 = createLexeme("{");
-   lex1 = createLexeme("-1.3");
-   lex2 = createLexeme("1.3");
-   lex3 = createLexeme("-1");
-   lex4 = createLexeme("23");
-   lex5 = createLexeme("1");
-   lex6 = createLexeme("A");
-   lex7 = createLexeme("TEST");
-   lex8 = createLexeme("}");
    /*Test rule transform and FD, RT, LT*/
-   addLexeme(prog1,lex0);
-   addLexeme(prog1,lex1);
+   addLexeme(prog1, "{");
+   lex0 = prog1->code->current;
+   addLexeme(prog1, "-1.3");
+   lex1 = prog1->code->current;
    prog1->code->current = lex0;
    assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex2);
+   addLexeme(prog1, "1.3");
+   lex2 = prog1->code->current;
    prog1->code->current = lex1;
    assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex3);
+   addLexeme(prog1, "-1");
+   lex3 = prog1->code->current;
    prog1->code->current = lex2;
    assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex4);
+   addLexeme(prog1, "23");
+   lex4 = prog1->code->current;
    prog1->code->current = lex3;
    assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex5);
+   addLexeme(prog1, "1");
+   lex5 = prog1->code->current;
    prog1->code->current = lex4;
    assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex6);
+   addLexeme(prog1, "A");
+   lex6 = prog1->code->current;
    prog1->code->current = lex5;
    assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex7);
+   addLexeme(prog1, "TEST");
+   lex7 = prog1->code->current;
    prog1->code->current = lex6;
    assert(ruleTransform(prog1) == false);
    assert(prog1->valid == false);
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1,lex8);
+   addLexeme(prog1, "}");
+   lex8 = prog1->code->current;
    prog1->code->current = lex7;
    assert(ruleTransform(prog1) == false);
    assert(prog1->valid == false);
@@ -908,38 +3036,37 @@ void testParse(){
 
    /*Test FD, RT, LT works*/
    prog1 = createProgram();
-   lex0 = createLexeme("{");
-   addLexeme(prog1, lex0);
-   lex1 = createLexeme("FD");
-   lex2 = createLexeme("1.3");
-   addLexeme(prog1,lex1);
-   addLexeme(prog1,lex2);
-   prog1->code->current = lex2->prev;
+   addLexeme(prog1, "{");
+   lex0 = prog1->code->current;
+   addLexeme(prog1, "FD");
+   lex1 = prog1->code->current;
+   addLexeme(prog1, "1.3");
+   lex2 = prog1->code->current;
+   prog1->code->current = lex2 - 1;
    assert(ruleInstruction(prog1) == true);
-   lex3 = createLexeme("RT");
-   lex4 = createLexeme("23");
-   addLexeme(prog1,lex3);
-   addLexeme(prog1,lex4);
-   prog1->code->current = lex4->prev;
+   addLexeme(prog1, "RT");
+   lex3 = prog1->code->current;
+   addLexeme(prog1, "23");
+   lex4 = prog1->code->current;
+   prog1->code->current = lex4 - 1;
    assert(ruleInstruction(prog1) == true);
-   lex5 = createLexeme("LT");
-   lex6 = createLexeme("A");
-   addLexeme(prog1,lex5);
-   addLexeme(prog1,lex6);
-   prog1->code->current = lex6->prev;
+   addLexeme(prog1, "LT");
+   lex5 = prog1->code->current;
+   addLexeme(prog1, "A");
+   lex6 = prog1->code->current;
+   prog1->code->current = lex6 - 1;
    assert(ruleInstruction(prog1) == true);
    /*check junk intructions don't work*/
-   lex7 = createLexeme("FD");
-   lex8 = createLexeme("ABC");
-   addLexeme(prog1, lex7);
-   addLexeme(prog1, lex8);
+   addLexeme(prog1, "FD");
+   lex7 = prog1->code->current;
+   addLexeme(prog1, "ABC");
+   lex8 = prog1->code->current;
    assert(ruleInstruction(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: No proper instruction found. "
       "Issue encountered at word 9: ABC.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   prog1->code->current = lex8->prev;
+   prog1->code->current = lex8 - 1;
    assert(ruleInstruction(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
@@ -948,52 +3075,54 @@ void testParse(){
 
    /*Test Polish and OP*/
    prog1 = createProgram();
-   lex0 = createLexeme("POLISH");
-   addLexeme(prog1, lex0);
+   addLexeme(prog1, "POLISH");
+   lex0 = prog1->code->current;
    assert(rulePolish(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null POLISH instruction. "
       "Issue encountered at word 1: POLISH.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex1 = createLexeme("+");
-   addLexeme(prog1, lex1);
-   assert(ruleOp(prog1) == true);
-   prog1->code->current = lex1->prev;
+   addLexeme(prog1, "+");
+   lex1 = prog1->code->current;
+   assert(ruleOp(prog1) == false);
+   prog1->valid = true;
+   prog1->exec->polishTop = 3;
+   assert(ruleOp(prog1) == true && prog1->exec->polishTop == 2);
+   prog1->code->current = lex1 - 1;
    assert(rulePolish(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null POLISH instruction. "
       "Issue encountered at word 2: +.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex2 = createLexeme(";");
-   addLexeme(prog1,lex2);
-   prog1->code->current = lex2->prev->prev;
-   assert(rulePolish(prog1) == true);
-   lex3 = createLexeme("++");
-   addLexeme(prog1, lex3);
+   addLexeme(prog1, ";");
+   lex2 = prog1->code->current;
+   prog1->code->current = lex2 - 2;
+   assert(rulePolish(prog1) == false);
+   assert(STREQ(prog1->errMessage, "Error: OP operated on a non-existant "
+      "number. Issue encountered at word 2: +.\n"));
+   prog1->valid = true;
+   addLexeme(prog1, "++");
+   lex3 = prog1->code->current;
    assert(ruleOp(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: OP is more than one character. "
       "Issue encountered at word 4: ++.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   prog1->code->current = lex3->prev;
+   prog1->code->current = lex3 - 1;
    assert(rulePolish(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: OP is more than one character. "
       "Issue encountered at word 4: ++.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex4 = createLexeme("A");
-   lex5 = createLexeme(";");
-   addLexeme(prog1, lex4);
-   addLexeme(prog1, lex5);
-   prog1->code->current = lex5->prev->prev;
+   addLexeme(prog1, "A");
+   lex4 = prog1->code->current;
+   addLexeme(prog1, ";");
+   lex5 = prog1->code->current;
+   prog1->code->current = lex5 - 2;
    assert(rulePolish(prog1) == true);
-   lex6 = createLexeme("AA");
-   addLexeme(prog1, lex6);
-   prog1->code->current = lex6->prev;
+   addLexeme(prog1, "AA");
+   lex6 = prog1->code->current;
+   prog1->code->current = lex6 - 1;
    assert(rulePolish(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
@@ -1002,118 +3131,121 @@ void testParse(){
 
    /*Test Set*/
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("SET"));
+   addLexeme(prog1, "SET");
    assert(ruleSet(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null SET instruction. "
       "Issue encountered at word 1: SET.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme(":="));
+   addLexeme(prog1, "A");
+   addLexeme(prog1, ":=");
    assert(ruleSet(prog1) == false);
    assert(prog1->valid == false);
    assert(strstr(prog1->errMessage, "Error: Expected := in SET instruction.") == NULL);
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("SET"));
-   addLexeme(prog1, createLexeme("A"));
-   prog1->code->current = prog1->code->current->prev;
+   addLexeme(prog1, "SET");
+   addLexeme(prog1, "A");
+   prog1->code->current = prog1->code->current - 1;
    assert(ruleSet(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected := in SET instruction. "
       "Issue encountered at word 2: A.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("A"));
-   prog1->code->current = prog1->code->current->prev->prev;
+   addLexeme(prog1, "A");
+   prog1->code->current = prog1->code->current - 2;
    assert(ruleSet(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected := in SET instruction. "
       "Issue encountered at word 3: A.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("SET"));
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme(":="));
-   addLexeme(prog1, createLexeme(";"));
-   prog1->code->current = prog1->code->current->prev->prev->prev;
+   addLexeme(prog1, "SET");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, ":=");
+   addLexeme(prog1, ";");
+   prog1->code->current = prog1->code->current - 3;
+   assert(ruleSet(prog1) == false);
+   assert(STREQ(prog1->errMessage, "Error: Attempted to use SET with null "
+      "value. Issue encountered at word 4: ;.\n"));
+   freeProgram(prog1);
+   prog1 = createProgram();
+   addLexeme(prog1, "SET");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, ":=");
+   addLexeme(prog1, "1");
+   addLexeme(prog1, ";");
+   prog1->code->current = 0;
    assert(ruleSet(prog1) == true);
    freeProgram(prog1);
 
    /*Test Do*/
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("DO"));
+   addLexeme(prog1, "DO");
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null DO instruction. "
       "Issue encountered at word 1: DO.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("A"));
-   prog1->code->current = prog1->code->current->prev;
+   addLexeme(prog1, "A");
+   prog1->code->current = prog1->code->current - 1;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected FROM in DO instruction. "
       "Issue encountered at word 2: A.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("FRO"));
-   prog1->code->current = prog1->code->current->prev->prev;
+   addLexeme(prog1, "FRO");
+   prog1->code->current = prog1->code->current - 2;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected FROM in DO instruction. "
       "Issue encountered at word 3: FRO.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("DO"));
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme("FROM"));
-   prog1->code->current = prog1->code->current->prev->prev;
+   addLexeme(prog1, "DO");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, "FROM");
+   prog1->code->current = prog1->code->current - 2;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected VARNUM in DO instruction. "
       "Issue encountered at word 3: FROM.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("1"));
-   prog1->code->current = prog1->code->current->prev->prev->prev;
+   addLexeme(prog1, "1");
+   prog1->code->current = prog1->code->current - 3;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected TO in DO instruction. "
       "Issue encountered at word 4: 1.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("TOT"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev;
+   addLexeme(prog1, "TOT");
+   prog1->code->current = prog1->code->current - 4;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected TO in DO instruction. "
       "Issue encountered at word 5: TOT.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("DO"));
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme("FROM"));
-   addLexeme(prog1, createLexeme("1"));
-   addLexeme(prog1, createLexeme("TO"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev;
+   addLexeme(prog1, "DO");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, "FROM");
+   addLexeme(prog1, "1");
+   addLexeme(prog1, "TO");
+   prog1->code->current = prog1->code->current - 4;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected VARNUM in DO instruction. "
       "Issue encountered at word 5: TO.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("5"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev->prev;
+   addLexeme(prog1, "5");
+   prog1->code->current = prog1->code->current - 5;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected { in DO instruction. "
       "Issue encountered at word 6: 5.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("{a"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev->prev->prev;
+   addLexeme(prog1, "{a");
+   prog1->code->current = prog1->code->current - 6;
    assert(ruleDo(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected { in DO instruction. "
@@ -1180,8 +3312,11 @@ void testParse(){
    assert(STREQ("Error: OP is more than one character. Issue encountered at word 6: ++.\n", errorMessage));
    assert(!testProgram("{ SET A := 1 & ; }", errorMessage));
    assert(STREQ("Error: VAR is an unexpected character. Issue encountered at word 6: &.\n", errorMessage));
-   assert(testProgram("{ SET A := 1 1 1.1 + + + + ; }", errorMessage));
-   assert(testProgram("{ SET A := 1 + + ; }", errorMessage));
+   assert(!testProgram("{ SET A := 1 1 1.1 + + + + ; }", errorMessage));
+   assert(STREQ("Error: OP operated on a non-existant number. Issue encountered at word 10: +.\n", errorMessage));
+   assert(!testProgram("{ SET A := 1 + + ; }", errorMessage));
+   assert(STREQ("Error: OP operated on a non-existant number. Issue encountered at word 6: +.\n", errorMessage));
+   assert(testProgram("{ SET A := 1 1 1.1 + + ; }", errorMessage));
    assert(!testProgram("{ SET A := 1; }", errorMessage));
    assert(STREQ("Error: VAR is too many characters. Issue encountered at word 5: 1;.\n", errorMessage));
    assert(testProgram("{ SET A := 1 ; }", errorMessage));
@@ -1232,25 +3367,102 @@ void testParse(){
    assert(STREQ("Error: Expected VARNUM in DO instruction. Issue encountered at word 6: TO.\n", errorMessage));
    assert(!testProgram("{ DO A FROM X TO X ", errorMessage));
    assert(STREQ("Error: Expected { in DO instruction. Issue encountered at word 7: X.\n", errorMessage));
+   assert(!testProgram("{ DO A FROM X TO X { ", errorMessage));
+   assert(STREQ("Error: Program did not end with }. Issue encountered at word 8: {.\n", errorMessage));
+   assert(!testProgram("{ DO A FROM 1 TO 2 { DO B FROM 1 TO 2 { FD 1 } ", errorMessage));
+   assert(STREQ("Error: Program did not end with }. Issue encountered at word 18: }.\n", errorMessage));
+   assert(testProgram("{ DO A FROM 1 TO 2 { DO B FROM 1 TO 2 { FD 1 } } RT 2 }", errorMessage));
    
    free(callocTest);
    free(seq1);
    freeProgram(prog1);
+
+   /*Test the lexer splits at any whitespace and keeps long words whole*/
+   prog1 = createProgram();
+   prog1->src = createTextSource("\t{ FD\n30\r\nRT 4.5 }\n   "
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      " ");
+   prog1->length = lexSource(prog1->src, prog1->code);
+   assert(prog1->length == 7 && prog1->code->count == 7);
+   assert(prog1->code->kinds[0] == TK_LBRACE);
+   assert(wordLength(prog1->code, 2) == 2);
+   assert(strncmp(wordText(prog1->code, 2), "30", 2) == 0);
+   assert(wordIndex(prog1->code, 2) == 3);
+   assert(wordValue(prog1->code, 4) > 4.49 && wordValue(prog1->code, 4) < 4.51);
+   assert(wordLength(prog1->code, prog1->code->current) == 74);
+   assert(wordIndex(prog1->code, prog1->code->current) == 7);
+   assert(prog1->code->kinds[prog1->code->current - 1] == TK_RBRACE);
+   assert(ruleMain(prog1) == true);
+   prog1->code->current = prog1->code->count - 1;
+   assert(setProgError(prog1, "test error") == false);
+   assert(strlen(prog1->errMessage) < ERRORBUFFER);
+   freeProgram(prog1);
+   assert(openSource("no/such/file.ttl") == NULL);
+
+   /*Test lexing a program in parts matches lexing it on one thread*/
+   text = (char *)smartCalloc(LEXTESTLINES * 40 + 1, sizeof(char));
+   end = text;
+   for (i = 0; i < LEXTESTLINES; i++){
+      strcpy(end, (i % 50 == 0) ? "{\tFD 30 RT -4.5 A 1-2 ++ ;; }\n{ "
+         : "{ FD 30 RT -4.5 SET A := A 2 * ; }\n");
+      end += strlen(end);
+   }
+   prog1 = createProgram();
+   prog1->src = createTextSource(text);
+   prog1->length = lexSourceThreads(prog1->src, prog1->code, 1, LEXMINPART);
+   assert(prog1->length == LEXTESTLINES * 13 - LEXTESTLINES / 50 * 2);
+   for (j = 2; j <= LEXTESTTHREADS; j++){
+      prog2 = createProgram();
+      prog2->src = createTextSource(text);
+      prog2->length = lexSourceThreads(prog2->src, prog2->code, j,
+         LEXTESTPART);
+      assert(prog2->length == prog1->length);
+      assert(prog2->code->count == prog2->length);
+      assert(memcmp(prog1->code->kinds, prog2->code->kinds, prog1->length)
+         == 0);
+      assert(memcmp(prog1->code->ops, prog2->code->ops, prog1->length) == 0);
+      assert(memcmp(prog1->code->lengths, prog2->code->lengths,
+         prog1->length * sizeof(unsigned short)) == 0);
+      assert(memcmp(prog1->code->offsets, prog2->code->offsets,
+         prog1->length * sizeof(unsigned int)) == 0);
+      assert(memcmp(prog1->code->values, prog2->code->values,
+         prog1->length * sizeof(int)) == 0);
+      assert(wordIndex(prog2->code, prog2->code->current) == prog2->length);
+      freeProgram(prog2);
+   }
+   freeProgram(prog1);
+   free(text);
+
+   /*Test a word too long for its stored length is measured from its text*/
+   text = (char *)smartCalloc(LONGWORD + 2, sizeof(char));
+   memset(text, 'A', LONGWORD + 1);
+   prog1 = createProgram();
+   addLexeme(prog1, text);
+   addLexeme(prog1, "FD");
+   assert(prog1->code->lengths[0] == LONGWORD);
+   assert(wordLength(prog1->code, 0) == LONGWORD + 1);
+   assert(wordLength(prog1->code, 1) == 2 && prog1->code->kinds[1] == TK_FD);
+   freeProgram(prog1);
+   free(text);
+
+   /*Test words are kept in arrays that grow rather than one allocation each*/
+   prog1 = createProgram();
+   for (i = 0; i < 1000; i++){
+      addLexeme(prog1, "FD");
+   }
+   assert(prog1->code->count == 1000 && prog1->code->capacity < 2000);
+   assert(prog1->code->kinds[999] == TK_FD);
+   assert(strncmp(wordText(prog1->code, 999), "FD", 2) == 0);
+   assert(prog1->mem->requests == 0);
+   assert(setProgError(prog1, "test error") == false);
+   assert(prog1->mem->requests == 1);
+   freeProgram(prog1);
 }
 
 bool testProgram(char *progText, char *errorMessage){
    program *p;
    bool fileValid;
-   char *token, text[200];
-   strcpy(text, progText);
-   p = createProgram();
-   token = strtok(text, WHITESPACE);
-   while (token != NULL){
-      if (addLexeme(p, createLexeme(token)) == false){
-         errorQuit("Couldn't add lexeme... exiting");
-      }
-      token = strtok(NULL, WHITESPACE);
-   }
+   p = createTestProgram(progText);
    ruleMain(p);
    if (p->valid == false){
       strcpy(errorMessage, p->errMessage);
@@ -1259,3 +3471,11 @@ bool testProgram(char *progText, char *errorMessage){
    freeProgram(p);
    return fileValid;
 }
+
+program *createTestProgram(char *progText){
+   program *p;
+   p = createProgram();
+   p->src = createTextSource(progText);
+   p->length = lexSource(p->src, p->code);
+   return p;
+}
@@ -0,0 +1,659 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <locale.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "lexer.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEXAVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__)
+#define LEXSSE2
+#include <emmintrin.h>
+#endif
+
+#define EXACTMANTISSA 900719925474098.0
+#define EXACTPOWER 22
+#define LEXBLOCK 32
+#define BLOCKBITS 0xffffffffUL
+#define CHARS 256
+#define LEXMAXTHREADS 64
+#define STARTWORDS 64
+#define SMALLVALUE 2147483647.0
+#define TEXTVALUE INT_MIN
+
+/*Bits of the class of a character. A character can be in more than one class:
+- is both numeric and an operator.*/
+enum charclass {CH_SPACE = 1, CH_DIGIT = 2, CH_NUMERIC = 4, CH_OP = 8,
+   CH_UPPER = 16};
+typedef enum charclass charclass;
+
+struct keyword{
+   char *word;
+   int length;
+   tokenkind kind;
+};
+typedef struct keyword keyword;
+
+/*A part of a source lexed on its own thread. Parts are split at whitespace so
+no word crosses into the next part. The words are first counted, so each part
+knows the position its words start from, then lexed straight into the arrays
+of the sequence.*/
+struct lexpart{
+   char *bytes;
+   size_t size;
+   int start;
+   int added;
+   sequence *code;
+};
+typedef struct lexpart lexpart;
+
+/*Returns a mask with bit i set if byte i of the LEXBLOCK bytes at c is
+whitespace*/
+typedef unsigned long (*spacescanner)(const char *c);
+
+/*The classes of every character, filled by initLexer*/
+static unsigned char classes[CHARS];
+
+/*The scanner lexSource finds whitespace with, chosen by initLexer for the
+processor the program runs on*/
+static spacescanner scanSpace = NULL;
+
+/*Makes initLexer run exactly once, whichever thread lexes first*/
+static pthread_once_t lexerReady = PTHREAD_ONCE_INIT;
+
+/*Fills the table of character classes from WHITESPACE, NUMCHARS and OPCHARS
+and sets scanSpace to the widest scanner the processor supports. It is only
+run through pthread_once on lexerReady.*/
+static void initLexer(void);
+
+/*Finds whitespace one byte at a time through the class table*/
+static unsigned long scanSpaceBytes(const char *c);
+
+#ifdef LEXSSE2
+/*Compares 16 bytes at a time with each whitespace character*/
+static unsigned long scanSpaceSse2(const char *c);
+#endif
+
+#ifdef LEXAVX2
+/*Compares all LEXBLOCK bytes at once with each whitespace character*/
+__attribute__((target("avx2")))
+static unsigned long scanSpaceAvx2(const char *c);
+#endif
+
+/*Returns the position of the lowest set bit of a mask that is not 0*/
+static int lowestBit(unsigned long mask);
+
+/*Finds the words of size bytes and sets the words of a sequence from position
+start on, growing the arrays when they are full. If s is NULL the words are
+only counted. Returns the number of words found.*/
+static int scanWords(char *bytes, size_t size, sequence *s, int start);
+
+/*Runs work on every part, the first on the calling thread and the others on
+threads of their own. A part whose thread cannot be started is done on the
+calling thread once the others have been started.*/
+static void runParts(lexpart *parts, int count, void *(*work)(void *));
+
+/*Counts the words of a part*/
+static void *countPart(void *arg);
+
+/*Lexes the words of a part into the positions of the sequence it was given*/
+static void *lexPart(void *arg);
+
+/*Makes the arrays of a sequence hold at least count words*/
+static void reserveWords(sequence *s, int count);
+
+/*Sets word i of a sequence to a view of length bytes at word, which must lie
+in the text of the sequence*/
+static void setWord(sequence *s, int i, char *word, int length);
+
+/*Sets the kind, leading operator and value of word i from its characters.
+This is the only place the rules look at the characters of a word.*/
+static void classifyWord(sequence *s, int i, char *word, int length);
+
+/*Reads everything left in a file descriptor into a buffer. Used when the
+source cannot be mapped.*/
+static int readSource(source *src, int fd);
+
+/*Quits the program when memory cannot be allocated*/
+static void lexerQuit(char *message);
+
+/*Checks and converts a word made of NUMCHARS in one pass, setting value and
+whole for a TK_NUMBER. whole is set if the value is a whole number that fits in
+an int, other than -0.
+Returns TK_WORD if the word has any other character, TK_BADNUMBER if it has a
+- after the start or more than one . and TK_NUMBER otherwise.*/
+static tokenkind scanNumber(char *word, int length, double *value, int *whole);
+
+/*Converts a number with strtod for literals too long to convert exactly with
+a single division. The . is swapped for the decimal point of the locale.*/
+static double slowNumber(char *word, int length);
+
+source *openSource(char *filename){
+   source *src;
+   struct stat info;
+   void *map;
+   int fd;
+   if ((fd = open(filename, O_RDONLY)) < 0){
+      return NULL;
+   }
+   src = (source *)calloc(1, sizeof(source));
+   if (src == NULL){
+      lexerQuit("Could not allocate memory...exiting");
+   }
+   if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+      map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED){
+         src->bytes = (char *)map;
+         src->size = info.st_size;
+         src->mapped = 1;
+         close(fd);
+         return src;
+      }
+   }
+   if (readSource(src, fd) == 0){
+      close(fd);
+      free(src->bytes);
+      free(src);
+      return NULL;
+   }
+   close(fd);
+   return src;
+}
+
+source *createTextSource(char *text){
+   source *src;
+   src = (source *)calloc(1, sizeof(source));
+   if (src == NULL || (src->bytes = (char *)malloc(strlen(text) + 1)) == NULL){
+      lexerQuit("Could not allocate memory...exiting");
+   }
+   strcpy(src->bytes, text);
+   src->size = strlen(text);
+   return src;
+}
+
+void closeSource(source *src){
+   if (src == NULL){
+      return;
+   }
+   if (src->mapped){
+      munmap(src->bytes, src->size);
+   }
+   else{
+      free(src->bytes);
+   }
+   free(src);
+}
+
+int lexSource(source *src, sequence *s){
+   return lexSourceThreads(src, s, (int)sysconf(_SC_NPROCESSORS_ONLN),
+      LEXMINPART);
+}
+
+int lexSourceThreads(source *src, sequence *s, int threads, size_t minPart){
+   lexpart parts[LEXMAXTHREADS];
+   size_t start = 0, end;
+   int i, added = 0;
+   if (src->size > UINT_MAX){
+      lexerQuit("Program is too large...exiting");
+   }
+   pthread_once(&lexerReady, initLexer);
+   s->text = src->bytes;
+   s->size = src->size;
+   if (minPart < 1){
+      minPart = 1;
+   }
+   if ((size_t)threads > src->size / minPart){
+      threads = (int)(src->size / minPart);
+   }
+   if (threads > LEXMAXTHREADS){
+      threads = LEXMAXTHREADS;
+   }
+   if (threads <= 1){
+      added = scanWords(src->bytes, src->size, s, s->count);
+      s->count += added;
+      s->current = s->count - 1;
+      return added;
+   }
+   for (i = 0; i < threads; i++){
+      end = (i == threads - 1) ? src->size : src->size / threads * (i + 1);
+      end = (end < start) ? start : end;
+      while (end < src->size && !(classes[(unsigned char)src->bytes[end]]
+         & CH_SPACE)){
+         end++;
+      }
+      parts[i].bytes = src->bytes + start;
+      parts[i].size = end - start;
+      parts[i].code = s;
+      start = end;
+   }
+   runParts(parts, threads, countPart);
+   for (i = 0; i < threads; i++){
+      parts[i].start = s->count + added;
+      added += parts[i].added;
+   }
+   reserveWords(s, s->count + added);
+   runParts(parts, threads, lexPart);
+   s->count += added;
+   s->current = s->count - 1;
+   return added;
+}
+
+int addWord(sequence *s, char *word, int length){
+   char *grown;
+   pthread_once(&lexerReady, initLexer);
+   if (s->copied + length + 1 > s->room){
+      s->room = (s->room == 0) ? READBUFFER : s->room;
+      while (s->copied + length + 1 > s->room){
+         s->room *= 2;
+      }
+      if ((grown = (char *)realloc(s->copies, s->room)) == NULL){
+         lexerQuit("Could not allocate memory...exiting");
+      }
+      s->copies = grown;
+   }
+   memcpy(s->copies + s->copied, word, length);
+   s->copies[s->copied + length] = ' ';
+   s->text = s->copies;
+   s->size = s->copied + length + 1;
+   reserveWords(s, s->count + 1);
+   setWord(s, s->count, s->copies + s->copied, length);
+   s->copied = s->size;
+   return s->count++;
+}
+
+void dropWords(sequence *s, int count){
+   size_t base;
+   int i;
+   count = (count > s->count) ? s->count : count;
+   if (count <= 0){
+      return;
+   }
+   if (s->text == s->copies && s->copies != NULL){
+      base = (count < s->count) ? s->offsets[count] : s->copied;
+      memmove(s->copies, s->copies + base, s->copied - base);
+      s->copied -= base;
+      s->size = s->copied;
+      for (i = count; i < s->count; i++){
+         s->offsets[i] -= base;
+      }
+   }
+   memmove(s->kinds, s->kinds + count, s->count - count);
+   memmove(s->ops, s->ops + count, s->count - count);
+   memmove(s->lengths, s->lengths + count,
+      (s->count - count) * sizeof(unsigned short));
+   memmove(s->offsets, s->offsets + count,
+      (s->count - count) * sizeof(unsigned int));
+   memmove(s->values, s->values + count, (s->count - count) * sizeof(int));
+   s->count -= count;
+   s->first += count;
+   s->current = (s->current >= count) ? s->current - count : NOWORD;
+}
+
+void freeWords(sequence *s){
+   free(s->kinds);
+   free(s->ops);
+   free(s->lengths);
+   free(s->offsets);
+   free(s->values);
+   free(s->copies);
+}
+
+char *wordText(sequence *s, int i){
+   return s->text + s->offsets[i];
+}
+
+int wordLength(sequence *s, int i){
+   size_t end = s->offsets[i] + LONGWORD;
+   if (s->lengths[i] < LONGWORD){
+      return s->lengths[i];
+   }
+   while (end < s->size && !(classes[(unsigned char)s->text[end]] & CH_SPACE)){
+      end++;
+   }
+   return (int)(end - s->offsets[i]);
+}
+
+double wordValue(sequence *s, int i){
+   double value;
+   int whole;
+   if (s->values[i] != TEXTVALUE){
+      return s->values[i];
+   }
+   scanNumber(wordText(s, i), wordLength(s, i), &value, &whole);
+   return value;
+}
+
+int wordIndex(sequence *s, int i){
+   return s->first + i + 1;
+}
+
+int countChar(char *str, int length, char c){
+   int i, count = 0;
+   for (i = 0; i < length; i++){
+      if (str[i] == c){
+         count++;
+      }
+   }
+   return count;
+}
+
+static void initLexer(void){
+   int c;
+   for (c = 1; c < CHARS; c++){
+      classes[c] = (unsigned char)(
+         (strchr(WHITESPACE, c) != NULL) * CH_SPACE
+         | (c >= '0' && c <= '9') * CH_DIGIT
+         | (strchr(NUMCHARS, c) != NULL) * CH_NUMERIC
+         | (strchr(OPCHARS, c) != NULL) * CH_OP
+         | (isupper(c) && isalpha(c)) * CH_UPPER);
+   }
+   scanSpace = scanSpaceBytes;
+#ifdef LEXSSE2
+   scanSpace = scanSpaceSse2;
+#endif
+#ifdef LEXAVX2
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")){
+      scanSpace = scanSpaceAvx2;
+   }
+#endif
+}
+
+static unsigned long scanSpaceBytes(const char *c){
+   unsigned long mask = 0;
+   int i;
+   for (i = 0; i < LEXBLOCK; i++){
+      if (classes[(unsigned char)c[i]] & CH_SPACE){
+         mask |= 1UL << i;
+      }
+   }
+   return mask;
+}
+
+#ifdef LEXSSE2
+static unsigned long scanSpaceSse2(const char *c){
+   static const char spaces[] = WHITESPACE;
+   __m128i low = _mm_loadu_si128((const __m128i *)c);
+   __m128i high = _mm_loadu_si128((const __m128i *)(c + LEXBLOCK / 2));
+   __m128i lowSpace = _mm_setzero_si128(), highSpace = _mm_setzero_si128();
+   __m128i space;
+   unsigned int i;
+   for (i = 0; i < sizeof(spaces) - 1; i++){
+      space = _mm_set1_epi8(spaces[i]);
+      lowSpace = _mm_or_si128(lowSpace, _mm_cmpeq_epi8(low, space));
+      highSpace = _mm_or_si128(highSpace, _mm_cmpeq_epi8(high, space));
+   }
+   return (unsigned long)(unsigned int)_mm_movemask_epi8(lowSpace)
+      | (unsigned long)(unsigned int)_mm_movemask_epi8(highSpace)
+      << (LEXBLOCK / 2);
+}
+#endif
+
+#ifdef LEXAVX2
+__attribute__((target("avx2")))
+static unsigned long scanSpaceAvx2(const char *c){
+   static const char spaces[] = WHITESPACE;
+   __m256i bytes = _mm256_loadu_si256((const __m256i *)c);
+   __m256i found = _mm256_setzero_si256();
+   unsigned int i;
+   for (i = 0; i < sizeof(spaces) - 1; i++){
+      found = _mm256_or_si256(found,
+         _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(spaces[i])));
+   }
+   return (unsigned long)(unsigned int)_mm256_movemask_epi8(found);
+}
+#endif
+
+static int lowestBit(unsigned long mask){
+#ifdef __GNUC__
+   return __builtin_ctzl(mask);
+#else
+   int bit = 0;
+   while ((mask & 1UL) == 0){
+      mask >>= 1;
+      bit++;
+   }
+   return bit;
+#endif
+}
+
+static int scanWords(char *bytes, size_t size, sequence *s, int start){
+   char *word = NULL, *block, tail[LEXBLOCK];
+   unsigned long words, edges, previous = 0;
+   size_t offset;
+   int added = 0, bit;
+   for (offset = 0; offset < size; offset += LEXBLOCK){
+      block = bytes + offset;
+      if (size - offset < LEXBLOCK){
+         memset(tail, ' ', LEXBLOCK);
+         memcpy(tail, block, size - offset);
+         words = ~scanSpace(tail) & BLOCKBITS;
+      }
+      else{
+         words = ~scanSpace(block) & BLOCKBITS;
+      }
+      edges = (words ^ ((words << 1) | previous)) & BLOCKBITS;
+      previous = words >> (LEXBLOCK - 1);
+      while (edges != 0){
+         bit = lowestBit(edges);
+         edges &= edges - 1;
+         if (word == NULL){
+            word = block + bit;
+         }
+         else{
+            if (s != NULL){
+               reserveWords(s, start + added + 1);
+               setWord(s, start + added, word, (int)(block + bit - word));
+            }
+            added++;
+            word = NULL;
+         }
+      }
+   }
+   if (word != NULL){
+      if (s != NULL){
+         reserveWords(s, start + added + 1);
+         setWord(s, start + added, word, (int)(bytes + size - word));
+      }
+      added++;
+   }
+   return added;
+}
+
+static void runParts(lexpart *parts, int count, void *(*work)(void *)){
+   pthread_t workers[LEXMAXTHREADS];
+   int started[LEXMAXTHREADS];
+   int i;
+   for (i = 1; i < count; i++){
+      started[i] = (pthread_create(&workers[i], NULL, work, &parts[i]) == 0);
+   }
+   work(&parts[0]);
+   for (i = 1; i < count; i++){
+      if (started[i]){
+         pthread_join(workers[i], NULL);
+      }
+      else{
+         work(&parts[i]);
+      }
+   }
+}
+
+static void *countPart(void *arg){
+   lexpart *part = (lexpart *)arg;
+   part->added = scanWords(part->bytes, part->size, NULL, 0);
+   return NULL;
+}
+
+static void *lexPart(void *arg){
+   lexpart *part = (lexpart *)arg;
+   scanWords(part->bytes, part->size, part->code, part->start);
+   return NULL;
+}
+
+static void reserveWords(sequence *s, int count){
+   int capacity = (s->capacity == 0) ? STARTWORDS : s->capacity;
+   if (count <= s->capacity){
+      return;
+   }
+   while (capacity < count){
+      capacity *= 2;
+   }
+   s->kinds = (unsigned char *)realloc(s->kinds, capacity);
+   s->ops = (char *)realloc(s->ops, capacity);
+   s->lengths = (unsigned short *)realloc(s->lengths,
+      capacity * sizeof(unsigned short));
+   s->offsets = (unsigned int *)realloc(s->offsets,
+      capacity * sizeof(unsigned int));
+   s->values = (int *)realloc(s->values, capacity * sizeof(int));
+   if (s->kinds == NULL || s->ops == NULL || s->lengths == NULL
+      || s->offsets == NULL || s->values == NULL){
+      lexerQuit("Could not allocate memory...exiting");
+   }
+   s->capacity = capacity;
+}
+
+static void setWord(sequence *s, int i, char *word, int length){
+   s->offsets[i] = (unsigned int)(word - s->text);
+   s->lengths[i] = (unsigned short)((length < LONGWORD) ? length : LONGWORD);
+   classifyWord(s, i, word, length);
+}
+
+static void classifyWord(sequence *s, int i, char *word, int length){
+   static keyword keywords[KEYWORDS] = {{"{", 1, TK_LBRACE},
+      {"}", 1, TK_RBRACE}, {"FD", 2, TK_FD}, {"RT", 2, TK_RT},
+      {"LT", 2, TK_LT}, {"DO", 2, TK_DO}, {"FROM", 4, TK_FROM},
+      {"TO", 2, TK_TO}, {"SET", 3, TK_SET}, {":=", 2, TK_ASSIGN},
+      {";", 1, TK_SEMICOLON}};
+   int k, kind, whole;
+   tokenkind number;
+   double value;
+   char first = (length > 0) ? word[0] : '\0';
+   kind = classes[(unsigned char)first];
+   s->ops[i] = (first != '\0' && (kind & CH_OP)) ? first : '\0';
+   s->kinds[i] = TK_WORD;
+   s->values[i] = 0;
+   for (k = 0; k < KEYWORDS; k++){
+      if (keywords[k].length == length && keywords[k].word[0] == first
+         && memcmp(word, keywords[k].word, length) == 0){
+         s->kinds[i] = (unsigned char)keywords[k].kind;
+         return;
+      }
+   }
+   if (length == 1 && (kind & CH_UPPER)){
+      s->kinds[i] = TK_VAR;
+   }
+   else if ((kind & CH_NUMERIC)
+      && (number = scanNumber(word, length, &value, &whole)) != TK_WORD){
+      s->kinds[i] = (unsigned char)number;
+      if (number == TK_NUMBER){
+         s->values[i] = whole ? (int)value : TEXTVALUE;
+      }
+   }
+   else if (length == 1 && s->ops[i] != '\0'){
+      s->kinds[i] = TK_OP;
+   }
+}
+
+static tokenkind scanNumber(char *word, int length, double *value, int *whole){
+   double mantissa = 0, power = 1;
+   int i, digits = 0, places = 0, dots = 0, exact = 1, bad = 0;
+   char c;
+   for (i = 0; i < length; i++){
+      c = word[i];
+      if (c >= '0' && c <= '9'){
+         if (mantissa < EXACTMANTISSA){
+            mantissa = mantissa * 10 + (c - '0');
+         }
+         else{
+            exact = 0;
+         }
+         places += dots;
+         digits++;
+      }
+      else if (c == '.'){
+         bad |= dots++;
+      }
+      else if (c == '-'){
+         bad |= (i > 0);
+      }
+      else{
+         return TK_WORD;
+      }
+   }
+   if (bad){
+      return TK_BADNUMBER;
+   }
+   *whole = exact && dots == 0 && mantissa < SMALLVALUE
+      && (word[0] != '-' || mantissa >= 1 || digits == 0);
+   if (digits == 0){
+      *value = 0;
+   }
+   else if (exact && places <= EXACTPOWER){
+      for (i = 0; i < places; i++){
+         power *= 10;
+      }
+      *value = mantissa / power;
+      if (word[0] == '-'){
+         *value = -*value;
+      }
+   }
+   else{
+      *value = slowNumber(word, length);
+   }
+   return TK_NUMBER;
+}
+
+static double slowNumber(char *word, int length){
+   char *copy, *dot;
+   double value;
+   copy = (char *)malloc(length + 1);
+   if (copy == NULL){
+      lexerQuit("Could not allocate memory...exiting");
+   }
+   memcpy(copy, word, length);
+   copy[length] = '\0';
+   if ((dot = strchr(copy, '.')) != NULL){
+      *dot = localeconv()->decimal_point[0];
+   }
+   value = strtod(copy, NULL);
+   free(copy);
+   return value;
+}
+
+static int readSource(source *src, int fd){
+   size_t capacity = READBUFFER;
+   ssize_t got;
+   char *grown;
+   src->bytes = (char *)malloc(capacity);
+   if (src->bytes == NULL){
+      lexerQuit("Could not allocate memory...exiting");
+   }
+   src->size = 0;
+   while ((got = read(fd, src->bytes + src->size, capacity - src->size)) > 0){
+      src->size += got;
+      if (src->size == capacity){
+         capacity *= 2;
+         if ((grown = (char *)realloc(src->bytes, capacity)) == NULL){
+            lexerQuit("Could not allocate memory...exiting");
+         }
+         src->bytes = grown;
+      }
+   }
+   return got == 0;
+}
+
+static void lexerQuit(char *message){
+   fprintf(stderr, "%s\n", message);
+   exit(EXIT_FAILURE);
+}
@@ -0,0 +1,118 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <stddef.h>
+
+#define WHITESPACE "\n\f\r\t "
+#define NUMCHARS "-.0123456789"
+#define OPCHARS "+-/*"
+#define KEYWORDS 11
+#define READBUFFER 65536
+#define LONGWORD 65535
+#define LEXMINPART 1048576
+#define NOWORD -1
+
+/*The kind of a word is found once when it is read, so that the rules can
+dispatch on it without comparing strings. A lone - is a valid VARNUM as well as
+an operator, so POLISH checks the op field rather than the kind.*/
+enum tokenkind {TK_WORD, TK_LBRACE, TK_RBRACE, TK_FD, TK_RT, TK_LT, TK_DO,
+   TK_FROM, TK_TO, TK_SET, TK_ASSIGN, TK_SEMICOLON, TK_OP, TK_VAR, TK_NUMBER,
+   TK_BADNUMBER};
+typedef enum tokenkind tokenkind;
+
+/*The words of a program, held as parallel arrays indexed by position rather
+than as a list of structs, so a word takes 12 bytes and the parser reads the
+words in order from contiguous memory. Word i views lengths[i] bytes starting
+at offsets[i] in text. It is not terminated, so it must be printed with a
+precision of its length. A length of LONGWORD or more is stored as LONGWORD
+and found again from the text when it is needed. values holds the number a
+TK_NUMBER word was converted to when it fits in an int, which most literals
+do, otherwise the number is converted again from the text when it is used.
+Words lexed from a source view its bytes, while words added one at a time are
+copied into copies, which text then points to. A sequence holds the words of
+one or the other, not both. first counts the words dropped from the front of
+the sequence, so word i is numbered first + i + 1 in error messages. current
+is the position of the word being parsed, or NOWORD.*/
+struct sequence{
+   unsigned char *kinds;
+   char *ops;
+   unsigned short *lengths;
+   unsigned int *offsets;
+   int *values;
+   char *text;
+   size_t size;
+   char *copies;
+   size_t copied;
+   size_t room;
+   int count;
+   int capacity;
+   int first;
+   int current;
+};
+typedef struct sequence sequence;
+
+/*The text of a program. Regular files are mapped into memory, anything else
+such as a pipe is read into a buffer. Words are views into bytes.*/
+struct source{
+   char *bytes;
+   size_t size;
+   int mapped;
+};
+typedef struct source source;
+
+/*Returns the source for a file, or NULL if the file could not be opened*/
+source *openSource(char *filename);
+
+/*Returns a source holding a copy of text. Used to lex programs held in
+strings.*/
+source *createTextSource(char *text);
+
+/*Unmaps or frees the bytes of a source and frees the source itself*/
+void closeSource(source *src);
+
+/*Splits a source at whitespace in a single pass and appends each word to the
+end of the sequence. The source is scanned 32 bytes at a time with SSE2 or
+AVX2 where the processor has them, and the words of each block are found from
+the bits of its whitespace mask. Large sources are lexed on as many threads as
+there are processors. Returns the number of words added and leaves current at
+the last word. Quits if the source is too large for the offsets of the
+words.*/
+int lexSource(source *src, sequence *s);
+
+/*Lexes a source like lexSource on up to threads threads. The source is split
+at whitespace into one part a thread, but never into parts smaller than
+minPart bytes. lexSource uses LEXMINPART, a megabyte. The words of every part
+are counted first, so the arrays of the sequence are grown once and each
+thread fills the positions of its own part. The result is the same as on one
+thread.*/
+int lexSourceThreads(source *src, sequence *s, int threads, size_t minPart);
+
+/*Appends a classified copy of length bytes of word to the end of the sequence
+and returns its position*/
+int addWord(sequence *s, char *word, int length);
+
+/*Drops the first count words of a sequence, along with their copies, and
+moves the others to the front. The numbers of the words that are left do not
+change.*/
+void dropWords(sequence *s, int count);
+
+/*Frees the arrays and copies of a sequence, but not the sequence itself*/
+void freeWords(sequence *s);
+
+/*Returns the first byte of word i*/
+char *wordText(sequence *s, int i);
+
+/*Returns the length of word i*/
+int wordLength(sequence *s, int i);
+
+/*Returns the number a TK_NUMBER word i was converted to*/
+double wordValue(sequence *s, int i);
+
+/*Returns the number of word i, counted from 1 at the start of the program*/
+int wordIndex(sequence *s, int i);
+
+/*Returns the number of times a character c appears in the first length
+characters of str*/
+int countChar(char *str, int length, char c);
+
+#endif
@@ -0,0 +1,735 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#define LLMAXCLASSES 64
+#define LLMAXRULES 64
+#define LLMAXALTS 256
+#define LLMAXLENGTH 32
+#define LLMAXMESSAGES 128
+#define LLMAXPOOL 8192
+#define LLMAXLINES 4096
+#define LLLINE 1024
+#define LLNAME 64
+#define LLERROR 200
+#define LLNOMESSAGE -1
+#define LLUNEXPECTED "Error: Unexpected word."
+#define LLCOLUMNS 77
+#define STREQ(A, B) (strcmp(A, B) == 0)
+
+enum llcell {CELL_EMPTY, CELL_PUSH, CELL_ERROR};
+typedef enum llcell llcell;
+
+/*A word class, named in the table by name and in the rules by alias, which is
+either a word in quotes or a lower case name*/
+struct llclass{
+   char name[LLNAME];
+   char alias[LLNAME];
+};
+typedef struct llclass llclass;
+
+/*One alternative of a rule. Symbols below the number of classes are classes
+and the rest are rules. message holds the message given if each symbol is
+missing, or LLNOMESSAGE. An error alternative has its message in error and
+the classes it applies to in symbols, and applies to every word that is left
+if it has none.*/
+struct llalt{
+   int lhs;
+   int symbols[LLMAXLENGTH];
+   int message[LLMAXLENGTH];
+   int length;
+   int error;
+};
+typedef struct llalt llalt;
+
+/*A grammar and the table built from it. The cell for a rule and a class is
+empty, an error with its message in value, or a sequence of symbols to push
+once the word has been read, which is length symbols of the pool from value
+on in the order they are met.*/
+struct llgrammar{
+   llclass classes[LLMAXCLASSES];
+   int classCount;
+   char rules[LLMAXRULES][LLNAME];
+   int ruleCount;
+   llalt alts[LLMAXALTS];
+   int altCount;
+   char *messages[LLMAXMESSAGES];
+   int messageCount;
+   int state[LLMAXRULES];
+   char first[LLMAXRULES][LLMAXCLASSES];
+   llcell cell[LLMAXRULES][LLMAXCLASSES];
+   int value[LLMAXRULES][LLMAXCLASSES];
+   int length[LLMAXRULES][LLMAXCLASSES];
+   int pool[LLMAXPOOL];
+   int poolMessage[LLMAXPOOL];
+   int poolCount;
+   char error[LLERROR];
+};
+typedef struct llgrammar llgrammar;
+
+/*Reads the %class lines and rules of a grammar from count lines of text.
+Returns 0 and sets the error of the grammar if they cannot be read.*/
+int readGrammar(llgrammar *g, char **lines, int count);
+
+/*Returns 1 if a line starts a rule*/
+int startsRule(char *line);
+
+/*Copies a token into a name of a class or rule. Returns 0 if it is too
+long.*/
+int copyName(char *name, char *token);
+
+/*Reads the alternatives of a rule from its text, which starts after ::=*/
+int readRule(llgrammar *g, int lhs, char *text);
+
+/*Returns a new empty alternative of a rule, or NULL if there are too many*/
+llalt *addAlt(llgrammar *g, int lhs);
+
+/*Finishes an alternative. A message left at its end makes it an error.
+Returns 0 if the alternative is empty.*/
+int endAlt(llgrammar *g, llalt *a, int message);
+
+/*Copies the next token of text into token and returns the text after it, or
+NULL at the end of the text. A token is a word, or a message in quotes.*/
+char *nextToken(char *text, char *token);
+
+/*Returns the symbol named by a token in a rule, or -1 if there is none*/
+int findSymbol(llgrammar *g, char *token);
+
+/*Returns the number of a message, adding it if it is new*/
+int addMessage(llgrammar *g, char *token);
+
+/*Builds the row of the table for every rule and checks the grammar is LL(1)
+and that every rule that can be reached with a new word has an entry for
+every class. Returns 0 and sets the error of the grammar if not.*/
+int buildTable(llgrammar *g);
+
+/*Builds the row of one rule after the rows of the rules its alternatives
+start with*/
+int buildRule(llgrammar *g, int rule);
+
+/*Fills the cell of a rule for class c from an alternative, following the
+cell of the rule the alternative starts with if it starts with one*/
+int deriveCell(llgrammar *g, llalt *a, int c);
+
+/*Writes the table as a C header for parse.c*/
+void writeTable(llgrammar *g, FILE *out, char *source);
+
+/*Writes an item of a list at column, after a comma unless it is the first,
+and starts a new line for it if the line would pass LLCOLUMNS. Returns the
+column after it.*/
+int writeItem(FILE *out, char *item, int column, int first);
+
+/*Sets name to the name of a symbol as it appears in the header*/
+void symbolName(llgrammar *g, int symbol, char *name);
+
+/*Sets the error of the grammar. Always returns 0.*/
+int setGrammarError(llgrammar *g, char *message, char *name);
+
+/*Frees the messages of a grammar*/
+void freeGrammar(llgrammar *g);
+
+/*Tests reading tokens, reading a small grammar, building its table, writing
+the header and rejecting grammars no table can be built for*/
+void testLlgen(void);
+
+int main(int argc, char **argv){
+   static char *lines[LLMAXLINES];
+   char line[LLLINE];
+   llgrammar *g;
+   FILE *in, *out;
+   int count = 0, ok;
+   testLlgen();
+   if (argc != 3){
+      fprintf(stderr, "Usage: %s grammar.txt parsetable.h\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   if ((in = fopen(argv[1], "r")) == NULL){
+      fprintf(stderr, "Could not open %s...exiting\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+   while (count < LLMAXLINES && fgets(line, LLLINE, in) != NULL){
+      if ((lines[count] = (char *)malloc(strlen(line) + 1)) == NULL){
+         fprintf(stderr, "Could not allocate memory...exiting\n");
+         return EXIT_FAILURE;
+      }
+      strcpy(lines[count++], line);
+   }
+   fclose(in);
+   if ((g = (llgrammar *)calloc(1, sizeof(llgrammar))) == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      return EXIT_FAILURE;
+   }
+   ok = readGrammar(g, lines, count) && buildTable(g);
+   while (count > 0){
+      free(lines[--count]);
+   }
+   if (ok == 0){
+      fprintf(stderr, "%s: %s\n", argv[1], g->error);
+      freeGrammar(g);
+      return EXIT_FAILURE;
+   }
+   if ((out = fopen(argv[2], "w")) == NULL){
+      fprintf(stderr, "Could not open %s...exiting\n", argv[2]);
+      freeGrammar(g);
+      return EXIT_FAILURE;
+   }
+   writeTable(g, out, argv[1]);
+   fclose(out);
+   freeGrammar(g);
+   return 0;
+}
+
+int readGrammar(llgrammar *g, char **lines, int count){
+   char token[LLLINE], body[LLLINE], *text;
+   int i, rule = -1;
+   g->messageCount = 0;
+   addMessage(g, "\"" LLUNEXPECTED "\"");
+   /*Every class and rule is named before any alternative is read, so rules
+   can use rules written after them*/
+   for (i = 0; i < count; i++){
+      text = nextToken(lines[i], token);
+      if (text != NULL && STREQ(token, "%class")){
+         if (g->classCount == LLMAXCLASSES){
+            return setGrammarError(g, "too many classes", "");
+         }
+         if ((text = nextToken(text, token)) == NULL
+            || copyName(g->classes[g->classCount].name, token) == 0
+            || nextToken(text, token) == NULL
+            || copyName(g->classes[g->classCount].alias, token) == 0){
+            return setGrammarError(g, "%class needs a name and a word", "");
+         }
+         g->classCount++;
+      }
+      else if (startsRule(lines[i])){
+         if (g->ruleCount == LLMAXRULES){
+            return setGrammarError(g, "too many rules", "");
+         }
+         nextToken(lines[i], token);
+         if (copyName(g->rules[g->ruleCount++], token) == 0){
+            return setGrammarError(g, "name is too long", token);
+         }
+      }
+   }
+   if (g->ruleCount == 0){
+      return setGrammarError(g, "there are no rules", "");
+   }
+   /*A rule runs on to the next blank line, rule or class*/
+   for (i = 0; i < count; i++){
+      if (startsRule(lines[i]) == 0){
+         continue;
+      }
+      strcpy(body, strstr(lines[i], "::=") + 3);
+      while (i + 1 < count && nextToken(lines[i + 1], token) != NULL
+         && startsRule(lines[i + 1]) == 0 && !STREQ(token, "%class")){
+         if (strlen(body) + strlen(lines[++i]) + 2 > LLLINE){
+            return setGrammarError(g, "rule is too long", g->rules[rule + 1]);
+         }
+         strcat(body, " ");
+         strcat(body, lines[i]);
+      }
+      if (readRule(g, ++rule, body) == 0){
+         return 0;
+      }
+   }
+   return 1;
+}
+
+int startsRule(char *line){
+   char token[LLLINE];
+   return nextToken(line, token) != NULL && token[0] == '<'
+      && strstr(line, "::=") != NULL;
+}
+
+int copyName(char *name, char *token){
+   if (strlen(token) >= LLNAME){
+      return 0;
+   }
+   strcpy(name, token);
+   return 1;
+}
+
+int readRule(llgrammar *g, int lhs, char *text){
+   char token[LLLINE];
+   llalt *a;
+   int message = LLNOMESSAGE, symbol;
+   if ((a = addAlt(g, lhs)) == NULL){
+      return 0;
+   }
+   while ((text = nextToken(text, token)) != NULL){
+      if (STREQ(token, "|")){
+         if (endAlt(g, a, message) == 0 || (a = addAlt(g, lhs)) == NULL){
+            return 0;
+         }
+         message = LLNOMESSAGE;
+      }
+      else if (STREQ(token, "!")){
+         if ((text = nextToken(text, token)) == NULL || token[0] != '"'){
+            return setGrammarError(g, "! needs a message in", g->rules[lhs]);
+         }
+         message = addMessage(g, token);
+      }
+      else if ((symbol = findSymbol(g, token)) < 0){
+         return setGrammarError(g, "unknown symbol", token);
+      }
+      else if (a->length == LLMAXLENGTH){
+         return setGrammarError(g, "alternative is too long in",
+            g->rules[lhs]);
+      }
+      else{
+         a->symbols[a->length] = symbol;
+         a->message[a->length++] = message;
+         message = LLNOMESSAGE;
+      }
+   }
+   return endAlt(g, a, message);
+}
+
+llalt *addAlt(llgrammar *g, int lhs){
+   llalt *a;
+   if (g->altCount == LLMAXALTS){
+      setGrammarError(g, "too many alternatives", "");
+      return NULL;
+   }
+   a = &g->alts[g->altCount++];
+   a->lhs = lhs;
+   a->length = 0;
+   a->error = LLNOMESSAGE;
+   return a;
+}
+
+int endAlt(llgrammar *g, llalt *a, int message){
+   a->error = message;
+   if (a->length == 0 && message == LLNOMESSAGE){
+      return setGrammarError(g, "empty alternative in", g->rules[a->lhs]);
+   }
+   return 1;
+}
+
+char *nextToken(char *text, char *token){
+   int length = 0;
+   while (*text != '\0' && isspace((unsigned char)*text)){
+      text++;
+   }
+   if (*text == '\0'){
+      return NULL;
+   }
+   if (*text == '"'){
+      /*A message may hold spaces, so it runs to the closing quote*/
+      token[length++] = *text++;
+      while (*text != '\0' && *text != '"'){
+         token[length++] = *text++;
+      }
+      if (*text == '"'){
+         token[length++] = *text++;
+      }
+   }
+   else{
+      while (*text != '\0' && !isspace((unsigned char)*text)){
+         token[length++] = *text++;
+      }
+   }
+   token[length] = '\0';
+   return text;
+}
+
+int findSymbol(llgrammar *g, char *token){
+   int i;
+   for (i = 0; i < g->classCount; i++){
+      if (STREQ(g->classes[i].alias, token)){
+         return i;
+      }
+   }
+   for (i = 0; i < g->ruleCount; i++){
+      if (STREQ(g->rules[i], token)){
+         return g->classCount + i;
+      }
+   }
+   return -1;
+}
+
+int addMessage(llgrammar *g, char *token){
+   int i, length = strlen(token) - 2;
+   for (i = 0; i < g->messageCount; i++){
+      if ((int)strlen(g->messages[i]) == length
+         && strncmp(g->messages[i], token + 1, length) == 0){
+         return i;
+      }
+   }
+   if (g->messageCount == LLMAXMESSAGES
+      || (g->messages[i] = (char *)malloc(length + 1)) == NULL){
+      fprintf(stderr, "Could not store message...exiting\n");
+      exit(EXIT_FAILURE);
+   }
+   memcpy(g->messages[i], token + 1, length);
+   g->messages[i][length] = '\0';
+   return g->messageCount++;
+}
+
+int buildTable(llgrammar *g){
+   int rule, c, i, j, after[LLMAXRULES];
+   llalt *a;
+   g->poolCount = 0;
+   memset(g->state, 0, sizeof(g->state));
+   memset(after, 0, sizeof(after));
+   for (rule = 0; rule < g->ruleCount; rule++){
+      if (buildRule(g, rule) == 0){
+         return 0;
+      }
+   }
+   /*A rule met after a word has been read may see any class, so it needs an
+   entry for all of them. The first rule is met at the first word.*/
+   after[0] = 1;
+   for (i = 0; i < g->altCount; i++){
+      a = &g->alts[i];
+      for (j = 0; a->error == LLNOMESSAGE && j < a->length; j++){
+         if (j > 0 && a->message[j] == LLNOMESSAGE){
+            return setGrammarError(g, "a symbol after the first has no "
+               "message in", g->rules[a->lhs]);
+         }
+         if (j > 0 && a->symbols[j] >= g->classCount){
+            after[a->symbols[j] - g->classCount] = 1;
+         }
+      }
+   }
+   for (rule = 0; rule < g->ruleCount; rule++){
+      for (c = 0; after[rule] && c < g->classCount; c++){
+         if (g->cell[rule][c] == CELL_EMPTY){
+            setGrammarError(g, "no alternative or error for", g->rules[rule]);
+            strcat(g->error, " and ");
+            strcat(g->error, g->classes[c].alias);
+            return 0;
+         }
+      }
+   }
+   return 1;
+}
+
+int buildRule(llgrammar *g, int rule){
+   llalt *a;
+   int i, j, c, m, fallback = LLNOMESSAGE;
+   if (g->state[rule] == 2){
+      return 1;
+   }
+   if (g->state[rule] == 1){
+      return setGrammarError(g, "left recursion through", g->rules[rule]);
+   }
+   g->state[rule] = 1;
+   /*Every word class that starts an alternative chooses it*/
+   for (i = 0; i < g->altCount; i++){
+      a = &g->alts[i];
+      if (a->lhs != rule || a->error != LLNOMESSAGE){
+         continue;
+      }
+      m = a->symbols[0] - g->classCount;
+      if (m >= 0 && buildRule(g, m) == 0){
+         return 0;
+      }
+      for (c = 0; c < g->classCount; c++){
+         if ((m < 0 && a->symbols[0] == c) || (m >= 0 && g->first[m][c])){
+            if (g->cell[rule][c] != CELL_EMPTY){
+               setGrammarError(g, "not LL(1), more than one alternative of",
+                  g->rules[rule]);
+               strcat(g->error, " starts with ");
+               strcat(g->error, g->classes[c].alias);
+               return 0;
+            }
+            g->first[rule][c] = 1;
+            if (deriveCell(g, a, c) == 0){
+               return 0;
+            }
+         }
+      }
+   }
+   /*Then the errors written for particular classes*/
+   for (i = 0; i < g->altCount; i++){
+      a = &g->alts[i];
+      if (a->lhs != rule || a->error == LLNOMESSAGE){
+         continue;
+      }
+      if (a->length == 0){
+         if (fallback != LLNOMESSAGE){
+            return setGrammarError(g, "more than one error for any word in",
+               g->rules[rule]);
+         }
+         fallback = a->error;
+      }
+      for (j = 0; j < a->length; j++){
+         c = a->symbols[j];
+         if (c >= g->classCount){
+            return setGrammarError(g, "an error can only follow classes in",
+               g->rules[rule]);
+         }
+         if (g->cell[rule][c] == CELL_PUSH){
+            return setGrammarError(g, "an error is given for a class that "
+               "starts an alternative of", g->rules[rule]);
+         }
+         g->cell[rule][c] = CELL_ERROR;
+         g->value[rule][c] = a->error;
+      }
+   }
+   /*Then the classes a rule an alternative starts with has an error for, so
+   the error comes from that rule*/
+   for (i = 0; i < g->altCount; i++){
+      a = &g->alts[i];
+      m = a->symbols[0] - g->classCount;
+      if (a->lhs != rule || a->error != LLNOMESSAGE || m < 0){
+         continue;
+      }
+      for (c = 0; c < g->classCount; c++){
+         if (g->cell[rule][c] == CELL_EMPTY && g->cell[m][c] != CELL_EMPTY
+            && deriveCell(g, a, c) == 0){
+            return 0;
+         }
+      }
+   }
+   for (c = 0; fallback != LLNOMESSAGE && c < g->classCount; c++){
+      if (g->cell[rule][c] == CELL_EMPTY){
+         g->cell[rule][c] = CELL_ERROR;
+         g->value[rule][c] = fallback;
+      }
+   }
+   g->state[rule] = 2;
+   return 1;
+}
+
+int deriveCell(llgrammar *g, llalt *a, int c){
+   int m = a->symbols[0] - g->classCount, from = 0, count = 0, i;
+   if (m >= 0 && g->cell[m][c] == CELL_ERROR){
+      g->cell[a->lhs][c] = CELL_ERROR;
+      g->value[a->lhs][c] = g->value[m][c];
+      return 1;
+   }
+   if (m >= 0){
+      from = g->value[m][c];
+      count = g->length[m][c];
+   }
+   if (g->poolCount + count + a->length > LLMAXPOOL){
+      return setGrammarError(g, "the table is too large at", g->rules[a->lhs]);
+   }
+   g->cell[a->lhs][c] = CELL_PUSH;
+   g->value[a->lhs][c] = g->poolCount;
+   g->length[a->lhs][c] = count + a->length - 1;
+   for (i = 0; i < count; i++){
+      g->pool[g->poolCount] = g->pool[from + i];
+      g->poolMessage[g->poolCount++] = g->poolMessage[from + i];
+   }
+   for (i = 1; i < a->length; i++){
+      g->pool[g->poolCount] = a->symbols[i];
+      g->poolMessage[g->poolCount++] = a->message[i];
+   }
+   return 1;
+}
+
+void writeTable(llgrammar *g, FILE *out, char *source){
+   int rule, c, i, j, count = 0, total = 0, longest = 0, found, column;
+   char item[LLNAME + LLNAME];
+   int *sequence = (int *)calloc(g->ruleCount * g->classCount, sizeof(int));
+   int *starts = (int *)calloc(g->ruleCount * g->classCount + 1, sizeof(int));
+   int *from = (int *)calloc(g->ruleCount * g->classCount, sizeof(int));
+   int *lengths = (int *)calloc(g->ruleCount * g->classCount, sizeof(int));
+   if (sequence == NULL || starts == NULL || from == NULL || lengths == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      exit(EXIT_FAILURE);
+   }
+   /*Cells that push the same symbols with the same messages share one
+   sequence*/
+   for (rule = 0; rule < g->ruleCount; rule++){
+      for (c = 0; c < g->classCount; c++){
+         if (g->cell[rule][c] != CELL_PUSH){
+            continue;
+         }
+         found = -1;
+         for (i = 0; i < count && found < 0; i++){
+            if (lengths[i] != g->length[rule][c]){
+               continue;
+            }
+            for (j = 0; j < lengths[i]; j++){
+               if (g->pool[from[i] + j] != g->pool[g->value[rule][c] + j]
+                  || g->poolMessage[from[i] + j]
+                  != g->poolMessage[g->value[rule][c] + j]){
+                  break;
+               }
+            }
+            found = (j == lengths[i]) ? i : -1;
+         }
+         if (found < 0){
+            found = count++;
+            from[found] = g->value[rule][c];
+            lengths[found] = g->length[rule][c];
+            starts[found] = total;
+            total += lengths[found];
+            starts[count] = total;
+            longest = (lengths[found] > longest) ? lengths[found] : longest;
+         }
+         sequence[rule * g->classCount + c] = found;
+      }
+   }
+   fprintf(out, "/*Generated by llgen from %s. Do not edit, change the "
+      "grammar and\nrebuild.*/\n#ifndef PARSETABLE_H\n"
+      "#define PARSETABLE_H\n\n", source);
+   fprintf(out, "#define WORDCLASSES %d\n#define LLRULES %d\n"
+      "#define LLMAXPUSH %d\n\n", g->classCount, g->ruleCount, longest);
+   column = fprintf(out, "enum wordclass {");
+   for (c = 0; c < g->classCount; c++){
+      symbolName(g, c, item);
+      column = writeItem(out, item, column, c == 0);
+   }
+   fprintf(out, "};\ntypedef enum wordclass wordclass;\n\n");
+   column = fprintf(out, "enum llsymbol {");
+   for (rule = 0; rule < g->ruleCount; rule++){
+      symbolName(g, g->classCount + rule, item);
+      strcat(item, (rule == 0) ? " = WORDCLASSES" : "");
+      column = writeItem(out, item, column, rule == 0);
+   }
+   fprintf(out, "};\ntypedef enum llsymbol llsymbol;\n\n/*The row of a rule "
+      "and the column of the class of the next word give the\nsequence of "
+      "symbols to push once the word is read, or the message to give\nas a "
+      "negative number, one less than minus its index.*/\n");
+   fprintf(out, "static const short llTable[LLRULES][WORDCLASSES] = {\n");
+   for (rule = 0; rule < g->ruleCount; rule++){
+      column = fprintf(out, "   {");
+      for (c = 0; c < g->classCount; c++){
+         sprintf(item, "%d", (g->cell[rule][c] == CELL_PUSH)
+            ? sequence[rule * g->classCount + c]
+            : -1 - (g->cell[rule][c] == CELL_ERROR ? g->value[rule][c] : 0));
+         column = writeItem(out, item, column, c == 0);
+      }
+      fprintf(out, "}%s\n", (rule < g->ruleCount - 1) ? "," : "");
+   }
+   fprintf(out, "};\n\n/*Sequence i is llPush[llPushStart[i]] up to "
+      "llPush[llPushStart[i + 1]], last\nsymbol first, so the symbol to match "
+      "next is pushed last. llPushMessage\nholds the message given if its "
+      "symbol is missing.*/\n");
+   column = fprintf(out, "static const unsigned short llPushStart[%d] = {",
+      count + 1);
+   for (i = 0; i <= count; i++){
+      sprintf(item, "%d", starts[i]);
+      column = writeItem(out, item, column, i == 0);
+   }
+   column = fprintf(out, "};\nstatic const unsigned char llPush[%d] = {",
+      total + 1) - 3;
+   for (i = 0; i < count; i++){
+      for (j = lengths[i] - 1; j >= 0; j--){
+         symbolName(g, g->pool[from[i] + j], item);
+         column = writeItem(out, item, column, i == 0 && j == lengths[i] - 1);
+      }
+   }
+   column = writeItem(out, "0", column, total == 0);
+   column = fprintf(out, "};\nstatic const unsigned char llPushMessage[%d] = "
+      "{", total + 1) - 3;
+   for (i = 0; i < count; i++){
+      for (j = lengths[i] - 1; j >= 0; j--){
+         sprintf(item, "%d", g->poolMessage[from[i] + j]);
+         column = writeItem(out, item, column, i == 0 && j == lengths[i] - 1);
+      }
+   }
+   writeItem(out, "0", column, total == 0);
+   fprintf(out, "};\n\nstatic char *llMessages[%d] = {\n", g->messageCount);
+   for (i = 0; i < g->messageCount; i++){
+      fprintf(out, "   \"%s\"%s\n", g->messages[i],
+         (i < g->messageCount - 1) ? "," : "");
+   }
+   fprintf(out, "};\n\n#endif\n");
+   free(sequence);
+   free(starts);
+   free(from);
+   free(lengths);
+}
+
+int writeItem(FILE *out, char *item, int column, int first){
+   if (first == 0){
+      column += fprintf(out, ",");
+   }
+   if (first == 0 && column + 1 + (int)strlen(item) > LLCOLUMNS){
+      column = fprintf(out, "\n   ") - 1;
+   }
+   else if (first == 0){
+      column += fprintf(out, " ");
+   }
+   return column + fprintf(out, "%s", item);
+}
+
+void symbolName(llgrammar *g, int symbol, char *name){
+   char *rule;
+   if (symbol < g->classCount){
+      sprintf(name, "WC_%s", g->classes[symbol].name);
+      return;
+   }
+   strcpy(name, "LL_");
+   name += strlen(name);
+   for (rule = g->rules[symbol - g->classCount]; *rule != '\0'; rule++){
+      if (isalnum((unsigned char)*rule)){
+         *name++ = toupper((unsigned char)*rule);
+      }
+      else if (*rule != '<' && *rule != '>'){
+         *name++ = '_';
+      }
+   }
+   *name = '\0';
+}
+int setGrammarError(llgrammar *g, char *message, char *name){
+   sprintf(g->error, "%.*s %.*s", LLERROR / 2, message, LLERROR / 2 - 2,
+      name);
+   return 0;
+}
+
+void freeGrammar(llgrammar *g){
+   int i;
+   for (i = 0; i < g->messageCount; i++){
+      free(g->messages[i]);
+   }
+   free(g);
+}
+
+void testLlgen(void){
+   static char *lines[] = {"%class A \"a\"", "%class B b", "%class C \"c\"",
+      "<S> ::= \"a\" ! \"Error: S.\" <T>", "   | ! \"Error: Start.\"", "",
+      "<T> ::= b | <U>", "   | \"c\" ! \"Error: C.\"", "",
+      "<U> ::= \"a\" ! \"Error: U.\" <S>"};
+   static char *conflict[] = {"%class A a", "<S> ::= a | <T>", "<T> ::= a"};
+   static char *missing[] = {"%class A a", "%class B b",
+      "<S> ::= a ! \"Error: S.\" <T> | ! \"Error: Start.\"", "<T> ::= a"};
+   static char *left[] = {"%class A a", "<S> ::= <T> ! \"Error: S.\" a",
+      "<T> ::= <S>"};
+   char token[LLLINE];
+   llgrammar *g;
+   FILE *out;
+   assert(nextToken("  \"{\" ! \"Error: Expected { here.\" <X>", token));
+   assert(STREQ(token, "\"{\""));
+   assert(STREQ(nextToken(nextToken(" ! \"Error: A { b.\" <X>", token),
+      token), " <X>"));
+   assert(STREQ(token, "\"Error: A { b.\""));
+   assert(nextToken("   \n", token) == NULL);
+   g = (llgrammar *)calloc(1, sizeof(llgrammar));
+   assert(g != NULL && readGrammar(g, lines, 10) == 1);
+   assert(g->classCount == 3 && g->ruleCount == 3 && g->altCount == 6);
+   assert(g->messageCount == 5 && STREQ(g->messages[0], LLUNEXPECTED));
+   assert(buildTable(g) == 1);
+   /*<S> reads a and then needs <T>, which gives its own error for c*/
+   assert(g->cell[0][0] == CELL_PUSH && g->length[0][0] == 1);
+   assert(g->pool[g->value[0][0]] == 4);
+   assert(g->cell[0][1] == CELL_ERROR && g->value[0][1] == 2);
+   assert(g->cell[1][0] == CELL_PUSH && g->length[1][0] == 1);
+   assert(g->cell[1][1] == CELL_PUSH && g->length[1][1] == 0);
+   assert(g->cell[1][2] == CELL_ERROR && g->value[1][2] == 3);
+   assert(g->cell[2][1] == CELL_EMPTY);
+   out = tmpfile();
+   assert(out != NULL);
+   writeTable(g, out, "test");
+   fclose(out);
+   freeGrammar(g);
+   g = (llgrammar *)calloc(1, sizeof(llgrammar));
+   assert(readGrammar(g, conflict, 3) == 1 && buildTable(g) == 0);
+   assert(strstr(g->error, "not LL(1)") != NULL);
+   freeGrammar(g);
+   g = (llgrammar *)calloc(1, sizeof(llgrammar));
+   assert(readGrammar(g, missing, 4) == 1 && buildTable(g) == 0);
+   assert(strstr(g->error, "<T> and b") != NULL);
+   freeGrammar(g);
+   g = (llgrammar *)calloc(1, sizeof(llgrammar));
+   assert(readGrammar(g, left, 3) == 1 && buildTable(g) == 0);
+   assert(strstr(g->error, "left recursion") != NULL);
+   freeGrammar(g);
+}
@@ -3,91 +3,71 @@
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <time.h>
+#include "arena.h"
+#include "lexer.h"
+#include "parsetable.h"
 
 #define COMMANDARGS 2
 #define FILEINDEX 1
-#define FILEBUFFER 50
 #define STARTNUM 30
-#define ERRORBUFFER 100
-#define WHITESPACE "\n\f\r\t "
-#define DIGITS "0123456789"
-#define NUMCHARS "-.0123456789"
+#define ERRORBUFFER 200
+#define ERRORWORD 64
+#define VALIDATETIME 1.0
+#define WORDSHAPES 4
+#define SHAPEOP 2
+#define SHAPESINGLE 1
 #define STREQ(A, B) (strcmp(A, B) == 0)
 
 enum bool {false, true};
 typedef enum bool bool;
 
-struct lexeme{
-   char *word;
-   int index;
-   struct lexeme *next;
-   struct lexeme *prev;
-};
-typedef struct lexeme lexeme;
-
-struct sequence{
-   lexeme *start;
-   lexeme *current;
-};
-typedef struct sequence sequence;
-
 struct program{
    sequence *code;
    int length;
    bool valid;
    char *errMessage;
+   arena *mem;
+   source *src;
 };
 typedef struct program program;
 
 /*Reads a file and generates a sequence of words by delimiting the file at
-whitespace characters. These words are added to the returned program struct.*/
+whitespace characters. These words are added to the returned program struct and
+are views into the mapped file rather than copies.*/
 program *readProgramFile(char *filename);
 
 /*Returns true if a program follows the rule for the <MAIN> grammar*/
 bool ruleMain(program *p);
 
-/*A recursive function that returns true if all instructions in a program
-follows the rules defined by <INSTRCTLST> and <INSTRUCTION> grammar*/
-bool ruleInstrctList(program *p);
-
-/*Returns true if an instruction follows <INSTRUCTION> grammar*/
-bool ruleInstruction(program *p);
-
-/*Returns true if the subsequent word for FD, RT, and LT instructions
-is a valid variable or number.*/
-bool ruleTransform(program *p);
-
-/*Returns true if the DO instruction follows the correct grammar*/
-bool ruleDo(program *p);
-
-/*Returns true if the DO instruction has correct FROM and TO grammar*/
-bool ruleDoInfo(program *p);
+/*Returns true if the words from the current one on follow the rule for a
+symbol of the grammar in grammar.txt, and leaves the current word on the last
+word the rule read. Rules are not functions of their own but rows of the parse
+table llgen builds from the grammar, so each word costs one lookup and the
+symbols still to be matched are kept on a stack.*/
+bool parseSymbol(program *p, int symbol);
 
-/*Returns true if the DO instruction has the correct FROM grammar*/
-bool ruleDoFrom(program *p);
+/*Fills classes with the class in the grammar of a word of each kind and
+shape. Unlike its kind the class tells apart the words the rules give
+different errors for, but depends on nothing else than the kind and shape, so
+parseSymbol looks it up in this table.*/
+void fillWordClasses(unsigned char classes[][WORDSHAPES]);
 
-/*Returns true if the DO instruction has the correct TO grammar*/
-bool ruleDoTo(program *p);
+/*Returns the shape of word i: SHAPEOP if it starts with an operator, plus
+SHAPESINGLE if it is one character long*/
+int wordShape(sequence *s, int i);
 
-/*Returns true if the SET instruction has the correct grammar*/
-bool ruleSet(program *p);
+/*Returns the class of words of a kind, which start with an operator if op is
+true and are one character long if single is true*/
+wordclass classifyShape(tokenkind kind, bool op, bool single);
 
-/*A recursive function that returns true if a POLISH expression has the
-correct grammar*/
-bool rulePolish(program *p);
-
-/*Returns true if the current word is a valid operator*/
-bool ruleOp(program *p);
-
-/*Returns true if the current word meets the criteria for <VARNUM> grammar*/
-bool ruleVarnum(program *p);
+/*Validates a program over and over for VALIDATETIME seconds and prints how
+fast it went*/
+void timeValidation(program *p);
 
 /*Returns the number of times a character c appears in a string*/
 int charFrequency(char *str, char c);
 
-/*Returns true if the current word meets the criteria for the <VAR> grammar*/
-bool ruleVar(program *p);
-
 /*Only returns false. Stops file reading and sets the error message in a
 program struct when grammar rules aren't met.*/
 bool setProgError(program *p, char *message);
@@ -95,15 +75,12 @@ bool setProgError(program *p, char *message);
 /*Returns an initialised program struct that contains a sequence of words*/
 program *createProgram();
 
-/*Returns a sequence struct that will hold a doubly linked list of words*/
+/*Returns an empty sequence of words with no current word*/
 sequence *createSequence();
 
-/*Returns a lexeme struct that that will hold a word from a file*/
-lexeme *createLexeme(char *word);
-
-/*Returns true when the word is added to the program. This increases the
-program's length variable and updates the index of the current word.*/
-bool addLexeme(program *p, lexeme *word);
+/*Returns true when a copy of word is added to the end of the program. This
+increases the program's length variable and makes the word the current one.*/
+bool addLexeme(program *p, char *word);
 
 /*Used to calloc space and check for failed memory allocation. If allocation
 fails, the program quits.*/
@@ -112,15 +89,13 @@ void *smartCalloc(int quantity, int size);
 /*Quits the program and prints the specified message to stderr*/
 void errorQuit(char *message);
 
-/*Frees memory allocated for a program structure*/
+/*Frees memory allocated for a program structure. The error message is
+released with the arena of the program and the words with its sequence.*/
 void freeProgram(program *p);
 
 /*Frees memory allocated for a sequence structure*/
 void freeSequence(sequence *s);
 
-/*Frees memory allocated for a lexeme structure*/
-void freeLexeme(lexeme *lex);
-
 /*Used to test functions adn functionality of parser*/
 void test();
 
@@ -130,12 +105,17 @@ bool testProgram(char *progText, char *errorMessage);
 int main(int argc, char **argv) {
    program *p;
    char *filename;
+   bool timed;
    test();
-   if (argc != COMMANDARGS){
+   timed = (argc == COMMANDARGS + 1 && STREQ(argv[FILEINDEX], "-t"));
+   if (argc != COMMANDARGS && timed == false){
       errorQuit("Incorrent command arguments...exiting.");
    }
-   filename = argv[FILEINDEX];
+   filename = argv[argc - 1];
    p = readProgramFile(filename);
+   if (timed == true){
+      timeValidation(p);
+   }
    ruleMain(p);
    if (p->valid == false){
       printf("%s", p->errMessage);
@@ -145,247 +125,148 @@ int main(int argc, char **argv) {
 }
 
 program *readProgramFile(char *filename){
-   char buffer[FILEBUFFER];
-   char *token;
-   FILE *fp;
    program *p;
    p = createProgram();
-
-   if ((fp = fopen(filename, "r")) == NULL){
+   if ((p->src = openSource(filename)) == NULL){
       errorQuit("Could not open file...exiting");
    }
-   while (fgets(buffer, FILEBUFFER, fp) != NULL){
-      token = strtok(buffer, WHITESPACE);
-      while (token != NULL){
-         if (addLexeme(p, createLexeme(token)) == false){
-            errorQuit("Couldn't add lexeme... exiting");
-         }
-         token = strtok(NULL, WHITESPACE);
-      }
-   }
-   fclose(fp);
+   p->length = lexSource(p->src, p->code);
    return p;
 }
 
 bool ruleMain(program *p){
-   p->code->current = p->code->start;
-   if (!STREQ(p->code->current->word,"{")){
-      return setProgError(p, "Error: Program did not start with {.");
-   }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Program did not end with }.");
-   }
-   p->code->current = p->code->current->next;
-   return ruleInstrctList(p);
-}
-
-bool ruleInstrctList(program *p){
-   if (STREQ(p->code->current->word,"}")){
-      return p->valid;
-   }
-   if (ruleInstruction(p) == false){
-      return p->valid;
-   }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Program did not end with }.");
-   }
-   p->code->current = p->code->current->next;
-   return ruleInstrctList(p);
-}
-
-bool ruleInstruction(program *p){
-   if (STREQ(p->code->current->word, "FD")){
-      return ruleTransform(p);
-   }
-   else if (STREQ(p->code->current->word, "RT")){
-      return ruleTransform(p);
-   }
-   else if (STREQ(p->code->current->word, "LT")){
-      return ruleTransform(p);
-   }
-   else if (STREQ(p->code->current->word, "DO")){
-      return ruleDo(p);
+   if (p->code->count == 0){
+      addLexeme(p, "");
    }
-   else if (STREQ(p->code->current->word, "SET")){
-      return ruleSet(p);
-   }
-   return setProgError(p, "Error: No proper instruction found.");
-}
-
-bool ruleTransform(program *p){
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: No VARNUM found.");
-   }
-   p->code->current = p->code->current->next;
-   return ruleVarnum(p);
-}
-
-bool ruleDo(program *p){
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Null DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (ruleVar(p) == false){
-      return p->valid;
-   }
-   if (ruleDoInfo(p) == false){
-      return p->valid;
-   }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Expected { in DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word,"{")){
-      return setProgError(p, "Error: Expected { in DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   return ruleInstrctList(p);
-}
-
-bool ruleDoInfo(program *p){
-   if (ruleDoFrom(p) == false){
-      return p->valid;
-   }
-   if (ruleDoTo(p) == false){
-      return p->valid;
-   }
-   return p->valid;
-}
-
-bool ruleDoFrom(program *p){
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Expected FROM in DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word, "FROM")){
-      return setProgError(p, "Error: Expected FROM in DO instruction.");
-   }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Expected VARNUM in DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (ruleVarnum(p) == false){
-      return p->valid;
-   }
-   return p->valid;
-}
-
-bool ruleDoTo(program *p){
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Expected TO in DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word, "TO")){
-      return setProgError(p, "Error: Expected TO in DO instruction.");
-   }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Expected VARNUM in DO instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (ruleVarnum(p) == false){
-      return p->valid;
-   }
-   return p->valid;
+   p->code->current = 0;
+   return parseSymbol(p, LL_MAIN);
 }
 
-bool ruleSet(program *p){
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Null SET instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (ruleVar(p) == false){
-      return p->valid;
-   }
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Expected := in SET instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (!STREQ(p->code->current->word, ":=")){
-      return setProgError(p, "Error: Expected := in SET instruction.");
+bool parseSymbol(program *p, int symbol){
+   sequence *s = p->code;
+   int last = s->current, word = s->current;
+   char *message = NULL;
+   int *stack, capacity = STARTNUM, top = -1, pos = 0, rule, i;
+   static unsigned char classes[TK_BADNUMBER + 1][WORDSHAPES];
+   static bool ready = false;
+   wordclass kind;
+   if (ready == false){
+      fillWordClasses(classes);
+      ready = true;
+   }
+   kind = (wordclass)classes[s->kinds[word]][wordShape(s, word)];
+   stack = (int *)smartCalloc(capacity, sizeof(int));
+   while (true){
+      if (symbol < WORDCLASSES && symbol != (int)kind){
+         message = llMessages[llPushMessage[pos]];
+         break;
+      }
+      if (symbol >= WORDCLASSES){
+         if ((rule = llTable[symbol - WORDCLASSES][kind]) < 0){
+            message = llMessages[-rule - 1];
+            break;
+         }
+         if (top + LLMAXPUSH >= capacity){
+            capacity *= 2;
+            if ((stack = (int *)realloc(stack, capacity * sizeof(int)))
+               == NULL){
+               errorQuit("Could not allocate memory...exiting\n");
+            }
+         }
+         for (i = llPushStart[rule]; i < llPushStart[rule + 1]; i++){
+            stack[++top] = i;
+         }
+      }
+      last = word++;
+      if (top < 0){
+         break;
+      }
+      pos = stack[top--];
+      symbol = llPush[pos];
+      if (word >= s->count){
+         message = llMessages[llPushMessage[pos]];
+         break;
+      }
+      kind = (wordclass)classes[s->kinds[word]][wordShape(s, word)];
    }
-   if (rulePolish(p) == false){
-      return p->valid;
+   free(stack);
+   s->current = (message != NULL && word < s->count) ? word : last;
+   if (message != NULL){
+      return setProgError(p, message);
    }
    return p->valid;
 }
 
-bool rulePolish(program *p){
-   if (p->code->current->next == NULL){
-      return setProgError(p, "Error: Null POLISH instruction.");
-   }
-   p->code->current = p->code->current->next;
-   if (STREQ(p->code->current->word, ";")){
-      return p->valid;
-   }
-   if (strspn(p->code->current->word, "+-/*") > 0){
-      if (ruleOp(p) == false){
-         return p->valid;
+void fillWordClasses(unsigned char classes[][WORDSHAPES]){
+   int kind, shape;
+   for (kind = 0; kind <= TK_BADNUMBER; kind++){
+      for (shape = 0; shape < WORDSHAPES; shape++){
+         classes[kind][shape] = (unsigned char)classifyShape((tokenkind)kind,
+            (shape & SHAPEOP) != 0, (shape & SHAPESINGLE) != 0);
       }
    }
-   else if (ruleVarnum(p) == false){
-      return p->valid;
-   }
-   return rulePolish(p);
 }
 
-bool ruleOp(program *p){
-   if (strlen(p->code->current->word) > 1){
-      return setProgError(p, "Error: OP is more than one character.");
-   }
-   return p->valid;
+int wordShape(sequence *s, int i){
+   return ((s->ops[i] != '\0') * SHAPEOP)
+      | ((s->lengths[i] == 1) * SHAPESINGLE);
 }
 
-bool ruleVarnum(program *p){
-   if (strspn(p->code->current->word, DIGITS)
-      == strlen(p->code->current->word)){
-         return p->valid;
-   }
-   if (strspn(p->code->current->word, NUMCHARS)
-      == strlen(p->code->current->word)){
-         if (charFrequency(p->code->current->word, '-') > 0){
-            if (charFrequency(p->code->current->word, '-') > 1
-            || p->code->current->word[0] != '-'){
-               return setProgError(p, "Error: VARNUM contains invalid characters.");
-            }
+wordclass classifyShape(tokenkind kind, bool op, bool single){
+   static const wordclass keywords[TK_SEMICOLON + 1] = {WC_WORD, WC_LBRACE,
+      WC_RBRACE, WC_FD, WC_RT, WC_LT, WC_DO, WC_FROM, WC_TO, WC_SET, WC_ASSIGN,
+      WC_SEMICOLON};
+   switch (kind){
+      case TK_VAR:
+         return WC_VAR;
+      case TK_OP:
+         return WC_OP;
+      case TK_NUMBER:
+         if (op == true){
+            return (single == true) ? WC_MINUS : WC_NEGATIVE;
          }
-      if (charFrequency(p->code->current->word, '.') > 1){
-         return setProgError(p, "Error: VARNUM contains invalid characters.");
-      }
-      return p->valid;
+         return (single == true) ? WC_DIGIT : WC_NUMBER;
+      case TK_BADNUMBER:
+         return (op == true) ? WC_NEGBAD : WC_BADNUMBER;
+      case TK_WORD:
+         if (op == true){
+            return WC_OPWORD;
+         }
+         return (single == true) ? WC_CHAR : WC_WORD;
+      default:
+         return keywords[kind];
    }
-   return ruleVar(p);
 }
 
-int charFrequency(char *str, char c){
-   int i = 0, count = 0;
-   while (i < (int) strlen(str)){
-      if (str[i] == c){
-         count++;
-      }
-      i++;
+void timeValidation(program *p){
+   clock_t start = clock();
+   double seconds = 0.0, megabytes;
+   long runs = 0;
+   megabytes = (p->src != NULL) ? p->src->size / 1e6 : 0.0;
+   while (seconds < VALIDATETIME){
+      p->valid = true;
+      ruleMain(p);
+      runs++;
+      seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
    }
-   return count;
+   p->valid = true;
+   printf("Validated %d words (%.2f MB) %ld times in %.2f s: %.1f MB/s\n",
+      p->length, megabytes, runs, seconds, megabytes * runs / seconds);
 }
 
-bool ruleVar(program *p){
-   char check;
-   if (strlen(p->code->current->word) > 1){
-      return setProgError(p,"Error: VAR is too many characters.");
-   }
-   check = p->code->current->word[0];
-   if (isupper(check) == false || isalpha(check) == false){
-      return setProgError(p,"Error: VAR is an unexpected character.");
-   }
-   return p->valid;
+int charFrequency(char *str, char c){
+   return countChar(str, strlen(str), c);
 }
 
 bool setProgError(program *p, char *message){
    char fullError[ERRORBUFFER];
+   sequence *s = p->code;
+   int length = wordLength(s, s->current);
    p->valid = false;
-   sprintf(fullError,"%s Issue encountered at word %d: %s.\n",
-      message, p->code->current->index, p->code->current->word);
-   p->errMessage = (char *)smartCalloc(strlen(fullError) + 1,sizeof(char));
-   strcpy(p->errMessage,fullError);
+   sprintf(fullError,"%s Issue encountered at word %d: %.*s.\n",
+      message, wordIndex(s, s->current),
+      length < ERRORWORD ? length : ERRORWORD, wordText(s, s->current));
+   p->errMessage = arenaStrdup(p->mem, fullError);
    return false;
 }
 
@@ -395,6 +276,7 @@ program *createProgram(){
    p = (program *)smartCalloc(1,sizeof(program));
    seq = createSequence();
    p->code = seq;
+   p->mem = createArena();
    p->length = 0;
    p->valid = true;
    return p;
@@ -403,34 +285,17 @@ program *createProgram(){
 sequence *createSequence(){
    sequence *s;
    s = (sequence *)smartCalloc(1, sizeof(sequence));
+   s->current = NOWORD;
    return s;
 }
 
-lexeme *createLexeme(char *word){
-   lexeme *lex;
-   lex = (lexeme *)smartCalloc(1,sizeof(lexeme));
-   lex->word = (char *)smartCalloc(strlen(word) + 1, sizeof(char));
-   lex->word = strcpy(lex->word,word);
-   return lex;
-}
-
-bool addLexeme(program *p, lexeme *word){
+bool addLexeme(program *p, char *word){
    if (p == NULL || word == NULL){
       return false;
    }
-   if (p->code->start == NULL){
-      p->code->start = word;
-      p->code->current = word;
-   }
-   else {
-      p->code->current->next = word;
-      word->prev = p->code->current;
-      p->code->current = word;
-
-   }
+   p->code->current = addWord(p->code, word, strlen(word));
    p->length++;
-   word->index = p->length;
-   return true;;
+   return true;
 }
 
 void *smartCalloc(int quantity, int size){
@@ -448,34 +313,27 @@ void errorQuit(char *message){
 }
 
 void freeProgram(program *p){
-   if (p->valid == false){
-      free(p->errMessage);
-   }
    freeSequence(p->code);
+   freeArena(p->mem);
+   closeSource(p->src);
    free(p);
 }
 
 void freeSequence(sequence *s){
-   lexeme *lex;
-   lex = s->start;
-   while(lex->next != NULL){
-      lex = lex->next;
-      freeLexeme(lex->prev);
-   }
-   freeLexeme(lex);
+   freeWords(s);
    free(s);
 }
 
-void freeLexeme(lexeme *lex){
-   free(lex->word);
-   free(lex);
-}
-
 void test(){
-   lexeme *lex0, *lex1, *lex2, *lex3, *lex4, *lex5, *lex6, *lex7, *lex8;
+   int lex0, lex1, lex2, lex3, lex4, lex6, lex8;
    sequence *seq1;
    program *prog1;
    char errorMessage[200], *callocTest;
+   static char *moves[3] = {"FD", "LT", "RT"};
+   static int moveRules[3] = {LL_FD, LL_LT, LL_RT};
+   static char *varnums[8] = {"-1.3", "1.3", "-1", "23", "1", "A", "TEST",
+      "}"};
+   int i;
 
    callocTest = smartCalloc(30, sizeof(char));
    assert(callocTest != NULL);
@@ -485,49 +343,81 @@ void test(){
    assert(charFrequency("octopodes", 'o') == 3);
    assert(charFrequency("zack", 'h') == 0);
 
+   /*Test words are classified when they are created*/
+   prog1 = createProgram();
+   addLexeme(prog1, "FD");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_FD
+      && wordLength(prog1->code, lex1) == 2 && prog1->code->ops[lex1] == '\0');
+   addLexeme(prog1, ":=");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_ASSIGN);
+   addLexeme(prog1, "Q");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_VAR);
+   addLexeme(prog1, "-1.5");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_NUMBER
+      && prog1->code->ops[lex1] == '-');
+   addLexeme(prog1, "1-5");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_BADNUMBER);
+   addLexeme(prog1, "1.5.");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_BADNUMBER);
+   addLexeme(prog1, "-");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_NUMBER
+      && prog1->code->ops[lex1] == '-');
+   addLexeme(prog1, "*");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_OP && prog1->code->ops[lex1] == '*');
+   addLexeme(prog1, "++");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_WORD
+      && prog1->code->ops[lex1] == '+' && wordLength(prog1->code, lex1) == 2);
+   addLexeme(prog1, "FROMA");
+   lex1 = prog1->code->current;
+   assert(prog1->code->kinds[lex1] == TK_WORD);
+   freeProgram(prog1);
+
    /*struct create testing*/
-   lex1 = createLexeme("test");
    seq1 = createSequence();
    prog1 = createProgram();
-   assert(lex1 != NULL);
-   assert(STREQ(lex1->word, "test"));
-   assert(lex1->index == 0);
-   assert(lex1->next ==NULL);
-   assert(lex1->prev == NULL);
-   assert(seq1->start == NULL);
-   assert(seq1->current == NULL);
-   assert(prog1->code->start == NULL);
-   assert(prog1->code->current == NULL);
+   assert(seq1->count == 0);
+   assert(seq1->current == NOWORD);
+   assert(prog1->code->count == 0);
+   assert(prog1->code->current == NOWORD);
    assert(prog1->length == 0);
    assert(prog1->valid == true);
    assert(prog1->errMessage == NULL);
 
    /*test adding lexemes*/
-   assert(addLexeme(NULL,lex1) == false);
-   assert(addLexeme(prog1,NULL) == false);
-   assert(addLexeme(prog1,lex1) == true);
-   assert(STREQ(prog1->code->start->word,lex1->word));
-   assert(STREQ(prog1->code->current->word,lex1->word));
+   assert(addLexeme(NULL, "test") == false);
+   assert(addLexeme(prog1, NULL) == false);
+   assert(addLexeme(prog1, "test") == true);
+   lex1 = prog1->code->current;
+   assert(lex1 == 0);
+   assert(strncmp(wordText(prog1->code, lex1), "test", 4) == 0);
+   assert(wordLength(prog1->code, lex1) == 4);
    assert(prog1->length == 1);
-   assert(lex1->index == 1);
-   assert(prog1->code->start->index == prog1->length);
-   lex2 = createLexeme("test2");
-   assert(STREQ(prog1->code->start->word, lex1->word));
-   assert(addLexeme(prog1,lex2) == true);
-   assert(STREQ(prog1->code->current->word, lex2->word));
-   assert(STREQ(prog1->code->start->next->word, lex2->word));
-   assert(STREQ(prog1->code->current->prev->word, lex1->word));
+   assert(wordIndex(prog1->code, lex1) == 1);
+   assert(wordIndex(prog1->code, 0) == prog1->length);
+   assert(addLexeme(prog1, "test2") == true);
+   lex2 = prog1->code->current;
+   assert(lex2 == lex1 + 1 && prog1->code->count == 2);
+   assert(strncmp(wordText(prog1->code, lex2), "test2", 5) == 0);
+   assert(wordLength(prog1->code, lex2) == 5);
    assert(prog1->length == 2);
-   assert(lex2->index == 2);
-   assert(prog1->code->current->index == prog1->length);
+   assert(wordIndex(prog1->code, lex2) == 2);
+   assert(wordIndex(prog1->code, prog1->code->current) == prog1->length);
 
-   prog1->code->current = prog1->code->start;
+   prog1->code->current = 0;
    assert(setProgError(prog1,"test error") == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "test error Issue encountered at word 1: "
       "test.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
 
    /*Test '{' and '}' start and end conditions for parser*/
    assert(ruleMain(prog1) == false);
@@ -537,149 +427,111 @@ void test(){
          "test.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   lex3 = createLexeme("{");
-   addLexeme(prog1, lex3);
+   addLexeme(prog1, "{");
+   lex3 = prog1->code->current;
    assert(ruleMain(prog1) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage,
          "Error: Program did not end with }. Issue encountered at word 1: "
          "{.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex5 = createLexeme("}");
-   addLexeme(prog1,lex5);
-   assert(ruleInstrctList(prog1) == true);
+   addLexeme(prog1, "}");
+   assert(parseSymbol(prog1, LL_INSTRCTLST) == true);
    assert(ruleMain(prog1) == true);
 
    freeProgram(prog1);
    prog1 = createProgram();
-   lex1 = createLexeme("-1.3");
-   lex2 = createLexeme("1.3");
-   lex3 = createLexeme("-1");
-   lex4 = createLexeme("23");
-   lex5 = createLexeme("1");
-   lex6 = createLexeme("A");
-   lex7 = createLexeme("TEST");
-   lex8 = createLexeme("}");
    /*Test var and varnum*/
-   addLexeme(prog1,lex1);
-   assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1,lex2);
-   assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1,lex3);
-   assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex4);
-   assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex5);
-   assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex6);
-   assert(ruleVar(prog1) == true);
-   assert(ruleVarnum(prog1) == true);
-   addLexeme(prog1, lex7);
-   assert(ruleVar(prog1) == false);
+   addLexeme(prog1, "-1.3");
+   lex1 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_VARNUM) == true);
+   addLexeme(prog1, "1.3");
+   lex2 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_VARNUM) == true);
+   addLexeme(prog1, "-1");
+   lex3 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_VARNUM) == true);
+   addLexeme(prog1, "23");
+   lex4 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_VARNUM) == true);
+   addLexeme(prog1, "1");
+   assert(parseSymbol(prog1, LL_VARNUM) == true);
+   addLexeme(prog1, "A");
+   lex6 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_VAR) == true);
+   assert(parseSymbol(prog1, LL_VARNUM) == true);
+   addLexeme(prog1, "TEST");
+   assert(parseSymbol(prog1, LL_VAR) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
       "Issue encountered at word 7: TEST.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   assert(ruleVarnum(prog1) == false);
+   assert(parseSymbol(prog1, LL_VARNUM) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
       "Issue encountered at word 7: TEST.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, lex8);
-   assert(ruleVar(prog1) == false);
+   addLexeme(prog1, "}");
+   lex8 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_VAR) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is an unexpected character. "
       "Issue encountered at word 8: }.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   assert(ruleVarnum(prog1) == false);
+   assert(parseSymbol(prog1, LL_VARNUM) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is an unexpected character. "
       "Issue encountered at word 8: }.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
 
    freeProgram(prog1);
-   prog1 = createProgram();
-   lex0 = createLexeme("{");
-   lex1 = createLexeme("-1.3");
-   lex2 = createLexeme("1.3");
-   lex3 = createLexeme("-1");
-   lex4 = createLexeme("23");
-   lex5 = createLexeme("1");
-   lex6 = createLexeme("A");
-   lex7 = createLexeme("TEST");
-   lex8 = createLexeme("}");
    /*Test rule transform and FD, RT, LT*/
-   addLexeme(prog1,lex0);
-   addLexeme(prog1,lex1);
-   prog1->code->current = lex0;
-   assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex2);
-   prog1->code->current = lex1;
-   assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex3);
-   prog1->code->current = lex2;
-   assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex4);
-   prog1->code->current = lex3;
-   assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex5);
-   prog1->code->current = lex4;
-   assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex6);
-   prog1->code->current = lex5;
-   assert(ruleTransform(prog1) == true);
-   addLexeme(prog1,lex7);
-   prog1->code->current = lex6;
-   assert(ruleTransform(prog1) == false);
-   assert(prog1->valid == false);
-   prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1,lex8);
-   prog1->code->current = lex7;
-   assert(ruleTransform(prog1) == false);
-   assert(prog1->valid == false);
+   prog1 = createProgram();
+   for (i = 0; i < 8; i++){
+      addLexeme(prog1, moves[i % 3]);
+      lex0 = prog1->code->current;
+      addLexeme(prog1, varnums[i]);
+      lex1 = prog1->code->current;
+      prog1->code->current = lex0;
+      assert(parseSymbol(prog1, moveRules[i % 3]) == (i < 6));
+      assert(prog1->valid == (i < 6));
+      assert(prog1->code->current == lex1);
+      prog1->valid = true;
+   }
    freeProgram(prog1);
 
    /*Test FD, RT, LT works*/
    prog1 = createProgram();
-   lex0 = createLexeme("{");
-   addLexeme(prog1, lex0);
-   lex1 = createLexeme("FD");
-   lex2 = createLexeme("1.3");
-   addLexeme(prog1,lex1);
-   addLexeme(prog1,lex2);
-   prog1->code->current = lex2->prev;
-   assert(ruleInstruction(prog1) == true);
-   lex3 = createLexeme("RT");
-   lex4 = createLexeme("23");
-   addLexeme(prog1,lex3);
-   addLexeme(prog1,lex4);
-   prog1->code->current = lex4->prev;
-   assert(ruleInstruction(prog1) == true);
-   lex5 = createLexeme("LT");
-   lex6 = createLexeme("A");
-   addLexeme(prog1,lex5);
-   addLexeme(prog1,lex6);
-   prog1->code->current = lex6->prev;
-   assert(ruleInstruction(prog1) == true);
+   addLexeme(prog1, "{");
+   lex0 = prog1->code->current;
+   addLexeme(prog1, "FD");
+   lex1 = prog1->code->current;
+   addLexeme(prog1, "1.3");
+   lex2 = prog1->code->current;
+   prog1->code->current = lex2 - 1;
+   assert(parseSymbol(prog1, LL_INSTRUCTION) == true);
+   addLexeme(prog1, "RT");
+   lex3 = prog1->code->current;
+   addLexeme(prog1, "23");
+   lex4 = prog1->code->current;
+   prog1->code->current = lex4 - 1;
+   assert(parseSymbol(prog1, LL_INSTRUCTION) == true);
+   addLexeme(prog1, "LT");
+   addLexeme(prog1, "A");
+   lex6 = prog1->code->current;
+   prog1->code->current = lex6 - 1;
+   assert(parseSymbol(prog1, LL_INSTRUCTION) == true);
    /*check junk intructions don't work*/
-   lex7 = createLexeme("FD");
-   lex8 = createLexeme("ABC");
-   addLexeme(prog1, lex7);
-   addLexeme(prog1, lex8);
-   assert(ruleInstruction(prog1) == false);
+   addLexeme(prog1, "FD");
+   addLexeme(prog1, "ABC");
+   lex8 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_INSTRUCTION) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: No proper instruction found. "
       "Issue encountered at word 9: ABC.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   prog1->code->current = lex8->prev;
-   assert(ruleInstruction(prog1) == false);
+   prog1->code->current = lex8 - 1;
+   assert(parseSymbol(prog1, LL_INSTRUCTION) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
       "Issue encountered at word 9: ABC.\n"));
@@ -687,173 +539,163 @@ void test(){
 
    /*Test Polish and OP*/
    prog1 = createProgram();
-   lex0 = createLexeme("POLISH");
-   addLexeme(prog1, lex0);
-   assert(rulePolish(prog1) == false);
+   addLexeme(prog1, "SET");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, ":=");
+   prog1->code->current = 0;
+   assert(parseSymbol(prog1, LL_SET) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null POLISH instruction. "
-      "Issue encountered at word 1: POLISH.\n"));
+      "Issue encountered at word 3: :=.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex1 = createLexeme("+");
-   addLexeme(prog1, lex1);
-   assert(ruleOp(prog1) == true);
-   prog1->code->current = lex1->prev;
-   assert(rulePolish(prog1) == false);
+   addLexeme(prog1, "+");
+   lex1 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_OP) == true);
+   prog1->code->current = 0;
+   assert(parseSymbol(prog1, LL_SET) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null POLISH instruction. "
-      "Issue encountered at word 2: +.\n"));
+      "Issue encountered at word 4: +.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex2 = createLexeme(";");
-   addLexeme(prog1,lex2);
-   prog1->code->current = lex2->prev->prev;
-   assert(rulePolish(prog1) == true);
-   lex3 = createLexeme("++");
-   addLexeme(prog1, lex3);
-   assert(ruleOp(prog1) == false);
+   addLexeme(prog1, ";");
+   lex2 = prog1->code->current;
+   prog1->code->current = 0;
+   assert(parseSymbol(prog1, LL_SET) == true);
+   assert(prog1->code->current == lex2);
+   addLexeme(prog1, "++");
+   lex3 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_OP) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: OP is more than one character. "
-      "Issue encountered at word 4: ++.\n"));
+      "Issue encountered at word 6: ++.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   prog1->code->current = lex3->prev;
-   assert(rulePolish(prog1) == false);
+   prog1->code->current = lex3;
+   assert(parseSymbol(prog1, LL_POLISH) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: OP is more than one character. "
-      "Issue encountered at word 4: ++.\n"));
+      "Issue encountered at word 6: ++.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   lex4 = createLexeme("A");
-   lex5 = createLexeme(";");
-   addLexeme(prog1, lex4);
-   addLexeme(prog1, lex5);
-   prog1->code->current = lex5->prev->prev;
-   assert(rulePolish(prog1) == true);
-   lex6 = createLexeme("AA");
-   addLexeme(prog1, lex6);
-   prog1->code->current = lex6->prev;
-   assert(rulePolish(prog1) == false);
+   addLexeme(prog1, "A");
+   lex4 = prog1->code->current;
+   addLexeme(prog1, ";");
+   prog1->code->current = lex4;
+   assert(parseSymbol(prog1, LL_POLISH) == true);
+   addLexeme(prog1, "AA");
+   lex6 = prog1->code->current;
+   assert(parseSymbol(prog1, LL_POLISH) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: VAR is too many characters. "
-      "Issue encountered at word 7: AA.\n"));
+      "Issue encountered at word 9: AA.\n"));
    freeProgram(prog1);
 
    /*Test Set*/
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("SET"));
-   assert(ruleSet(prog1) == false);
+   addLexeme(prog1, "SET");
+   assert(parseSymbol(prog1, LL_SET) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null SET instruction. "
       "Issue encountered at word 1: SET.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme(":="));
-   assert(ruleSet(prog1) == false);
+   addLexeme(prog1, "A");
+   addLexeme(prog1, ":=");
+   prog1->code->current = 0;
+   assert(parseSymbol(prog1, LL_SET) == false);
    assert(prog1->valid == false);
    assert(strstr(prog1->errMessage, "Error: Expected := in SET instruction.") == NULL);
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("SET"));
-   addLexeme(prog1, createLexeme("A"));
-   prog1->code->current = prog1->code->current->prev;
-   assert(ruleSet(prog1) == false);
+   addLexeme(prog1, "SET");
+   addLexeme(prog1, "A");
+   prog1->code->current = prog1->code->current - 1;
+   assert(parseSymbol(prog1, LL_SET) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected := in SET instruction. "
       "Issue encountered at word 2: A.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("A"));
-   prog1->code->current = prog1->code->current->prev->prev;
-   assert(ruleSet(prog1) == false);
+   addLexeme(prog1, "A");
+   prog1->code->current = prog1->code->current - 2;
+   assert(parseSymbol(prog1, LL_SET) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected := in SET instruction. "
       "Issue encountered at word 3: A.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("SET"));
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme(":="));
-   addLexeme(prog1, createLexeme(";"));
-   prog1->code->current = prog1->code->current->prev->prev->prev;
-   assert(ruleSet(prog1) == true);
+   addLexeme(prog1, "SET");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, ":=");
+   addLexeme(prog1, ";");
+   prog1->code->current = prog1->code->current - 3;
+   assert(parseSymbol(prog1, LL_SET) == true);
    freeProgram(prog1);
 
    /*Test Do*/
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("DO"));
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "DO");
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Null DO instruction. "
       "Issue encountered at word 1: DO.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("A"));
-   prog1->code->current = prog1->code->current->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "A");
+   prog1->code->current = prog1->code->current - 1;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected FROM in DO instruction. "
       "Issue encountered at word 2: A.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("FRO"));
-   prog1->code->current = prog1->code->current->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "FRO");
+   prog1->code->current = prog1->code->current - 2;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected FROM in DO instruction. "
       "Issue encountered at word 3: FRO.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("DO"));
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme("FROM"));
-   prog1->code->current = prog1->code->current->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "DO");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, "FROM");
+   prog1->code->current = prog1->code->current - 2;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected VARNUM in DO instruction. "
       "Issue encountered at word 3: FROM.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("1"));
-   prog1->code->current = prog1->code->current->prev->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "1");
+   prog1->code->current = prog1->code->current - 3;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected TO in DO instruction. "
       "Issue encountered at word 4: 1.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("TOT"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "TOT");
+   prog1->code->current = prog1->code->current - 4;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected TO in DO instruction. "
       "Issue encountered at word 5: TOT.\n"));
    freeProgram(prog1);
    prog1 = createProgram();
-   addLexeme(prog1, createLexeme("DO"));
-   addLexeme(prog1, createLexeme("A"));
-   addLexeme(prog1, createLexeme("FROM"));
-   addLexeme(prog1, createLexeme("1"));
-   addLexeme(prog1, createLexeme("TO"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "DO");
+   addLexeme(prog1, "A");
+   addLexeme(prog1, "FROM");
+   addLexeme(prog1, "1");
+   addLexeme(prog1, "TO");
+   prog1->code->current = prog1->code->current - 4;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected VARNUM in DO instruction. "
       "Issue encountered at word 5: TO.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("5"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "5");
+   prog1->code->current = prog1->code->current - 5;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected { in DO instruction. "
       "Issue encountered at word 6: 5.\n"));
    prog1->valid = true;
-   free(prog1->errMessage);
-   addLexeme(prog1, createLexeme("{a"));
-   prog1->code->current = prog1->code->current->prev->prev->prev->prev->prev->prev;
-   assert(ruleDo(prog1) == false);
+   addLexeme(prog1, "{a");
+   prog1->code->current = prog1->code->current - 6;
+   assert(parseSymbol(prog1, LL_DO) == false);
    assert(prog1->valid == false);
    assert(STREQ(prog1->errMessage, "Error: Expected { in DO instruction. "
       "Issue encountered at word 7: {a.\n"));
@@ -971,27 +813,60 @@ void test(){
    assert(STREQ("Error: Expected VARNUM in DO instruction. Issue encountered at word 6: TO.\n", errorMessage));
    assert(!testProgram("{ DO A FROM X TO X ", errorMessage));
    assert(STREQ("Error: Expected { in DO instruction. Issue encountered at word 7: X.\n", errorMessage));
+   assert(!testProgram("{ DO A FROM X TO X { ", errorMessage));
+   assert(STREQ("Error: Program did not end with }. Issue encountered at word 8: {.\n", errorMessage));
+   assert(!testProgram("{ DO A FROM 1 TO 2 { DO B FROM 1 TO 2 { FD 1 } ", errorMessage));
+   assert(STREQ("Error: Program did not end with }. Issue encountered at word 18: }.\n", errorMessage));
+   assert(testProgram("{ DO A FROM 1 TO 2 { DO B FROM 1 TO 2 { FD 1 } } RT 2 }", errorMessage));
 
 
 
    free(callocTest);
    free(seq1);
    freeProgram(prog1);
+
+   /*Test the lexer splits at any whitespace and keeps long words whole*/
+   prog1 = createProgram();
+   prog1->src = createTextSource("\t{ FD\n30\r\nRT 4.5 }\n   "
+      "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
+      " ");
+   prog1->length = lexSource(prog1->src, prog1->code);
+   assert(prog1->length == 7 && prog1->code->count == 7);
+   assert(prog1->code->kinds[0] == TK_LBRACE);
+   assert(wordLength(prog1->code, 2) == 2);
+   assert(strncmp(wordText(prog1->code, 2), "30", 2) == 0);
+   assert(wordIndex(prog1->code, 2) == 3);
+   assert(wordValue(prog1->code, 4) > 4.49 && wordValue(prog1->code, 4) < 4.51);
+   assert(wordLength(prog1->code, prog1->code->current) == 74);
+   assert(wordIndex(prog1->code, prog1->code->current) == 7);
+   assert(prog1->code->kinds[prog1->code->current - 1] == TK_RBRACE);
+   assert(ruleMain(prog1) == true);
+   prog1->code->current = prog1->code->count - 1;
+   assert(setProgError(prog1, "test error") == false);
+   assert(strlen(prog1->errMessage) < ERRORBUFFER);
+   freeProgram(prog1);
+   assert(openSource("no/such/file.ttl") == NULL);
+
+   /*Test words are kept in arrays that grow rather than one allocation each*/
+   prog1 = createProgram();
+   for (i = 0; i < 1000; i++){
+      addLexeme(prog1, "FD");
+   }
+   assert(prog1->code->count == 1000 && prog1->code->capacity < 2000);
+   assert(prog1->code->kinds[999] == TK_FD);
+   assert(strncmp(wordText(prog1->code, 999), "FD", 2) == 0);
+   assert(prog1->mem->requests == 0);
+   assert(setProgError(prog1, "test error") == false);
+   assert(prog1->mem->requests == 1);
+   freeProgram(prog1);
 }
 
 bool testProgram(char *progText, char *errorMessage){
    program *p;
    bool fileValid;
-   char *token, text[200];
-   strcpy(text, progText);
    p = createProgram();
-   token = strtok(text, WHITESPACE);
-   while (token != NULL){
-      if (addLexeme(p, createLexeme(token)) == false){
-         errorQuit("Couldn't add lexeme... exiting");
-      }
-      token = strtok(NULL, WHITESPACE);
-   }
+   p->src = createTextSource(progText);
+   p->length = lexSource(p->src, p->code);
    ruleMain(p);
    if (p->valid == false){
       strcpy(errorMessage, p->errMessage);
@@ -0,0 +1,1008 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "raster.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RASTERSIMD
+#include <immintrin.h>
+#endif
+
+#define SSELANES 4
+#define AVXLANES 8
+#define SIMDMINIMUM 32
+#define TILEMAXIMUM 256
+#define TILEMINIMUM 32
+#define TILESPERTHREAD 4
+#define RASTERQUEUE 262144
+#define RASTERMAXTHREADS 64
+
+/*A segment queued by rasterSegment, in pixels, with the colour it is drawn
+in*/
+struct rastersegment{
+   int x0;
+   int y0;
+   int x1;
+   int y1;
+   unsigned int colour;
+};
+typedef struct rastersegment rastersegment;
+
+/*A rectangle of the framebuffer from left to right - 1 and top to bottom - 1.
+As a tile it holds the indexes, in the order they were queued, of the
+segments that may draw in it.*/
+struct rastertile{
+   int left;
+   int top;
+   int right;
+   int bottom;
+   long *items;
+   long count;
+   long capacity;
+};
+typedef struct rastertile rastertile;
+
+/*Segments waiting to be drawn and the tiles they are sorted into, across
+tiles to a row. The segments are split into parts, one for each thread, that
+are sorted into their own copy of the tiles, so tiles holds parts times
+tileCount tiles. Workers take the job numbered next until every part has been
+sorted, and then again until every tile has been drawn.*/
+struct rasterqueue{
+   rastersegment *segments;
+   long count;
+   rastertile *tiles;
+   int tileSize;
+   int across;
+   int tileCount;
+   int parts;
+   int next;
+   pthread_mutex_t lock;
+};
+
+/*A line between two pixels, set up to be stepped along its major axis, the
+axis it is longest in. Pixel i is i steps along the major axis from the start
+and moves one step along the minor axis each time err reaches twice the major
+length, as in Bresenham's algorithm. first and last are the pixels inside the
+clipping rectangle along the major axis, and only pixels from minorLow to
+minorHigh - 1 along the minor axis are drawn. base is the index the start
+pixel would have and err, minor and addr describe the pixel the line is at.*/
+struct linestep{
+   int majorLength;
+   int minorLength;
+   int minorStart;
+   int minorDir;
+   int minorLow;
+   int minorHigh;
+   unsigned int colour;
+   long base;
+   long majorStride;
+   long minorStride;
+   long first;
+   long last;
+   int err;
+   int minor;
+   long addr;
+};
+typedef struct linestep linestep;
+
+/*Returns the widest path this machine supports*/
+static rasterpath bestPath(void);
+
+/*Sets up s for the line between two pixels, clipped to area. Returns 0 if
+none of its pixels are inside area along the major axis.*/
+static int clipLine(framebuffer *fb, rastertile *area, int x0, int y0, int x1,
+   int y1, linestep *s);
+
+/*Draws the part of a line inside area in the given colour with the path of
+the framebuffer*/
+static void drawClipped(framebuffer *fb, rastertile *area, int x0, int y0,
+   int x1, int y1, unsigned int colour);
+
+/*Adds a segment to the queue, drawing the queue first if it is full*/
+static void queueSegment(framebuffer *fb, int x0, int y0, int x1, int y1);
+
+/*Returns a queue with empty tiles covering the framebuffer. Each line drawn
+in a tile is clipped to it, so tiles are as large as they can be while there
+are still TILESPERTHREAD of them for each thread.*/
+static struct rasterqueue *createQueue(framebuffer *fb);
+
+/*Frees a queue and its tiles*/
+static void freeQueue(struct rasterqueue *q);
+
+/*Runs work on as many threads as the framebuffer has, but no more than jobs,
+and waits for them all to finish. The calling thread is one of them.*/
+static void runWorkers(framebuffer *fb, void *(*work)(void *), int jobs);
+
+/*Returns the number of the next job for a worker, or -1 once count jobs have
+been taken*/
+static int nextJob(struct rasterqueue *q, int count);
+
+/*Sorts parts of the queue into tiles until none are left. arg is the
+framebuffer.*/
+static void *binWorker(void *arg);
+
+/*Adds the index of each segment in a part of the queue to its copy of the
+tiles the segment may pass through. For each column or row of tiles along
+its major axis the line is followed with a pixel to spare each side, which
+covers every pixel Bresenham's algorithm picks.*/
+static void binSegments(framebuffer *fb, int part);
+
+/*Adds segment i to the end of a tile*/
+static void binTile(rastertile *tile, long i);
+
+/*Draws tiles until none are left, taking the parts of each tile in order.
+arg is the framebuffer.*/
+static void *drawWorker(void *arg);
+
+/*Draws the segments of a tile in the order they were queued, clipped to the
+tile*/
+static void drawTile(framebuffer *fb, rastertile *tile);
+
+/*Moves s to pixel i of its line. The products are formed in doubles, which
+hold them exactly, so the result is the same as stepping there one pixel at a
+time.*/
+static void seekLine(linestep *s, long i);
+
+/*Moves s on to the next pixel of its line*/
+static void advanceLine(linestep *s);
+
+/*Draws pixels first to last of a line one at a time*/
+static void stepScalar(framebuffer *fb, linestep *s);
+
+/*Draws a line whose end points are both inside area one pixel at a time,
+without setting up a linestep or testing pixels against the clipping
+rectangle. Returns 0, drawing nothing, if the line leaves area or has
+SIMDMINIMUM or more pixels on a path with vector steps, as those lines are
+left to the path of the framebuffer.*/
+static int stepInside(framebuffer *fb, rastertile *area, int x0, int y0,
+   int x1, int y1, unsigned int colour);
+
+#ifdef RASTERSIMD
+/*Draws pixels first to last of a line four at a time with SSE2. Each lane
+jumps four pixels per step, so the error term needs at most one correction.
+Rows are filled with vector stores. Lines of fewer than SIMDMINIMUM pixels
+are left to stepScalar, as setting up the lanes costs more than it saves.*/
+static void stepSSE2(framebuffer *fb, linestep *s);
+
+/*Draws pixels first to last of a line eight at a time with AVX2*/
+static void stepAVX2(framebuffer *fb, linestep *s);
+#endif
+
+/*Converts a window coordinate to a pixel, truncating towards zero like the
+SDL line functions. Values are clamped, and NaN goes to the lowest, so the
+conversion is always defined.*/
+static int toPixel(double v);
+
+/*Writes a four byte big-endian value*/
+static void putBig32(unsigned char *out, unsigned long v);
+
+/*Writes a PNG chunk of the given type and returns 0 if writing fails*/
+static int writeChunk(FILE *fp, char *type, unsigned char *data,
+   unsigned long length);
+
+/*Returns the CRC-32 of a buffer continuing from a previous crc*/
+static unsigned long crc32(unsigned long crc, unsigned char *buf,
+   unsigned long length);
+
+framebuffer *createFramebuffer(int width, int height, int winWidth,
+   int winHeight){
+   framebuffer *fb;
+   long i, count = (long)width * height;
+   fb = (framebuffer *)calloc(1, sizeof(framebuffer));
+   if (fb == NULL || (fb->pixels = (unsigned int *)malloc(count
+      * sizeof(unsigned int))) == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      exit(EXIT_FAILURE);
+   }
+   fb->width = width;
+   fb->height = height;
+   fb->scaleX = (double)width / winWidth;
+   fb->scaleY = (double)height / winHeight;
+   fb->colour = packColour(0, 0, 0);
+   for (i = 0; i < count; i++){
+      fb->pixels[i] = fb->colour;
+   }
+   setRasterColour(fb, 255, 255, 255);
+   fb->path = RASTER_SCALAR;
+   setRasterPath(fb, RASTER_SSE2);
+   fb->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if (setRasterThreads(fb, fb->threads) == 0){
+      fb->threads = 1;
+   }
+   return fb;
+}
+
+int setRasterThreads(framebuffer *fb, int threads){
+   if (threads < 1){
+      return 0;
+   }
+   flushSegments(fb);
+   freeQueue(fb->queue);
+   fb->queue = NULL;
+   fb->threads = (threads > RASTERMAXTHREADS) ? RASTERMAXTHREADS : threads;
+   return 1;
+}
+
+void flushSegments(framebuffer *fb){
+   struct rasterqueue *q = fb->queue;
+   int i;
+   if (q == NULL || q->count == 0){
+      return;
+   }
+   q->next = 0;
+   runWorkers(fb, binWorker, q->parts);
+   q->next = 0;
+   runWorkers(fb, drawWorker, q->tileCount);
+   for (i = 0; i < q->parts * q->tileCount; i++){
+      q->tiles[i].count = 0;
+   }
+   q->count = 0;
+}
+
+int setRasterPath(framebuffer *fb, rasterpath path){
+   if (path > bestPath() || (path != RASTER_SCALAR
+      && (long)fb->width * fb->height > INT_MAX)){
+      return 0;
+   }
+   fb->path = path;
+   return 1;
+}
+
+void setRasterColour(framebuffer *fb, int r, int g, int b){
+   fb->colour = packColour(r, g, b);
+}
+
+unsigned int packColour(int r, int g, int b){
+   unsigned char bytes[RGBA];
+   unsigned int colour;
+   bytes[0] = (unsigned char)r;
+   bytes[1] = (unsigned char)g;
+   bytes[2] = (unsigned char)b;
+   bytes[3] = 255;
+   memcpy(&colour, bytes, RGBA);
+   return colour;
+}
+
+void rasterSegment(framebuffer *fb, double x0, double y0, double x1,
+   double y1){
+   if (fb->threads > 1){
+      queueSegment(fb, toPixel(x0 * fb->scaleX), toPixel(y0 * fb->scaleY),
+         toPixel(x1 * fb->scaleX), toPixel(y1 * fb->scaleY));
+      return;
+   }
+   rasterLine(fb, toPixel(x0 * fb->scaleX), toPixel(y0 * fb->scaleY),
+      toPixel(x1 * fb->scaleX), toPixel(y1 * fb->scaleY));
+}
+
+void rasterSegments(framebuffer *fb, segmentbuffer *s, long first, long last){
+   unsigned char *rgb;
+   long i;
+   int colour = -1;
+   for (i = first; i < last; i++){
+      if (s->colours[i] != colour){
+         colour = s->colours[i];
+         rgb = s->palette[colour];
+         setRasterColour(fb, rgb[0], rgb[1], rgb[2]);
+      }
+      rasterSegment(fb, s->x0[i], s->y0[i], s->x1[i], s->y1[i]);
+   }
+}
+
+void rasterLine(framebuffer *fb, int x0, int y0, int x1, int y1){
+   rastertile whole;
+   if ((x0 < 0 && x1 < 0) || (y0 < 0 && y1 < 0)
+      || (x0 >= fb->width && x1 >= fb->width)
+      || (y0 >= fb->height && y1 >= fb->height)){
+      return;
+   }
+   whole.left = 0;
+   whole.top = 0;
+   whole.right = fb->width;
+   whole.bottom = fb->height;
+   drawClipped(fb, &whole, x0, y0, x1, y1, fb->colour);
+}
+
+void rasterLineReference(framebuffer *fb, int x0, int y0, int x1, int y1){
+   int dx, dy, sx, sy, i, err;
+   if ((x0 < 0 && x1 < 0) || (y0 < 0 && y1 < 0)
+      || (x0 >= fb->width && x1 >= fb->width)
+      || (y0 >= fb->height && y1 >= fb->height)){
+      return;
+   }
+   dx = abs(x1 - x0);
+   dy = abs(y1 - y0);
+   sx = (x0 < x1) ? 1 : -1;
+   sy = (y0 < y1) ? 1 : -1;
+   if (dx >= dy){
+      err = dx;
+      for (i = 0; i <= dx; i++){
+         if (x0 >= 0 && x0 < fb->width && y0 >= 0 && y0 < fb->height){
+            fb->pixels[(long)y0 * fb->width + x0] = fb->colour;
+         }
+         x0 += sx;
+         err += 2 * dy;
+         if (err >= 2 * dx){
+            err -= 2 * dx;
+            y0 += sy;
+         }
+      }
+   }
+   else{
+      err = dy;
+      for (i = 0; i <= dy; i++){
+         if (x0 >= 0 && x0 < fb->width && y0 >= 0 && y0 < fb->height){
+            fb->pixels[(long)y0 * fb->width + x0] = fb->colour;
+         }
+         y0 += sy;
+         err += 2 * dx;
+         if (err >= 2 * dy){
+            err -= 2 * dy;
+            x0 += sx;
+         }
+      }
+   }
+}
+
+int writeImage(framebuffer *fb, char *filename){
+   size_t length = strlen(filename);
+   flushSegments(fb);
+   if (length > 4 && strcmp(filename + length - 4, ".png") == 0){
+      return writePNG(fb, filename);
+   }
+   return writePPM(fb, filename);
+}
+
+int writePPM(framebuffer *fb, char *filename){
+   FILE *fp;
+   unsigned char *row, *px;
+   int x, y, ok = 1;
+   if ((fp = fopen(filename, "wb")) == NULL){
+      return 0;
+   }
+   row = (unsigned char *)malloc((size_t)fb->width * 3);
+   if (row == NULL){
+      fclose(fp);
+      return 0;
+   }
+   fprintf(fp, "P6\n%d %d\n255\n", fb->width, fb->height);
+   for (y = 0; y < fb->height; y++){
+      px = (unsigned char *)&fb->pixels[(long)y * fb->width];
+      for (x = 0; x < fb->width; x++){
+         memcpy(&row[x * 3], &px[x * RGBA], 3);
+      }
+      if (fwrite(row, 3, fb->width, fp) != (size_t)fb->width){
+         ok = 0;
+      }
+   }
+   free(row);
+   return (fclose(fp) == 0) && ok;
+}
+
+int writePNG(framebuffer *fb, char *filename){
+   static unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+   unsigned char header[13], *data, *out;
+   unsigned long rowBytes = (unsigned long)fb->width * RGBA + 1;
+   unsigned long raw = rowBytes * fb->height, blocks, length, i, left, take;
+   unsigned long a = 1, b = 0;
+   FILE *fp;
+   int y, ok;
+   /*zlib header, one 5 byte header per stored block and the adler-32*/
+   blocks = (raw + PNGSTORED - 1) / PNGSTORED;
+   length = 2 + blocks * 5 + raw + 4;
+   if ((data = (unsigned char *)malloc(raw)) == NULL
+      || (out = (unsigned char *)malloc(length)) == NULL){
+      free(data);
+      return 0;
+   }
+   for (y = 0; y < fb->height; y++){
+      data[y * rowBytes] = 0;
+      memcpy(&data[y * rowBytes + 1], &fb->pixels[(long)y * fb->width],
+         rowBytes - 1);
+   }
+   out[0] = 0x78;
+   out[1] = 0x01;
+   for (i = 0, left = raw, length = 2; left > 0; left -= take){
+      take = (left > PNGSTORED) ? PNGSTORED : left;
+      out[length++] = (left == take) ? 1 : 0;
+      out[length++] = take & 0xff;
+      out[length++] = (take >> 8) & 0xff;
+      out[length++] = ~take & 0xff;
+      out[length++] = (~take >> 8) & 0xff;
+      memcpy(&out[length], &data[i], take);
+      length += take;
+      i += take;
+   }
+   for (i = 0; i < raw; i++){
+      a = (a + data[i]) % 65521;
+      b = (b + a) % 65521;
+   }
+   putBig32(&out[length], (b << 16) | a);
+   length += 4;
+   putBig32(header, fb->width);
+   putBig32(header + 4, fb->height);
+   header[8] = 8;
+   header[9] = 6;
+   header[10] = header[11] = header[12] = 0;
+   if ((fp = fopen(filename, "wb")) == NULL){
+      free(data);
+      free(out);
+      return 0;
+   }
+   ok = fwrite(signature, 1, 8, fp) == 8
+      && writeChunk(fp, "IHDR", header, 13)
+      && writeChunk(fp, "IDAT", out, length)
+      && writeChunk(fp, "IEND", NULL, 0);
+   free(data);
+   free(out);
+   return (fclose(fp) == 0) && ok;
+}
+
+void freeFramebuffer(framebuffer *fb){
+   if (fb == NULL){
+      return;
+   }
+   freeQueue(fb->queue);
+   free(fb->pixels);
+   free(fb);
+}
+
+static int toPixel(double v){
+   if (v > RASTERLIMIT){
+      return RASTERLIMIT;
+   }
+   if (!(v >= -RASTERLIMIT)){
+      return -RASTERLIMIT;
+   }
+   return (int)v;
+}
+
+static void putBig32(unsigned char *out, unsigned long v){
+   out[0] = (v >> 24) & 0xff;
+   out[1] = (v >> 16) & 0xff;
+   out[2] = (v >> 8) & 0xff;
+   out[3] = v & 0xff;
+}
+
+static int writeChunk(FILE *fp, char *type, unsigned char *data,
+   unsigned long length){
+   unsigned char word[4];
+   unsigned long crc;
+   putBig32(word, length);
+   if (fwrite(word, 1, 4, fp) != 4 || fwrite(type, 1, 4, fp) != 4){
+      return 0;
+   }
+   crc = crc32(0xffffffffUL, (unsigned char *)type, 4);
+   if (length > 0){
+      if (fwrite(data, 1, length, fp) != length){
+         return 0;
+      }
+      crc = crc32(crc, data, length);
+   }
+   putBig32(word, crc ^ 0xffffffffUL);
+   return fwrite(word, 1, 4, fp) == 4;
+}
+
+static unsigned long crc32(unsigned long crc, unsigned char *buf,
+   unsigned long length){
+   unsigned long i;
+   int k;
+   for (i = 0; i < length; i++){
+      crc ^= buf[i];
+      for (k = 0; k < 8; k++){
+         crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320UL : crc >> 1;
+      }
+   }
+   return crc & 0xffffffffUL;
+}
+
+static rasterpath bestPath(void){
+#ifdef RASTERSIMD
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")){
+      return RASTER_AVX2;
+   }
+   if (__builtin_cpu_supports("sse2")){
+      return RASTER_SSE2;
+   }
+#endif
+   return RASTER_SCALAR;
+}
+
+static int clipLine(framebuffer *fb, rastertile *area, int x0, int y0, int x1,
+   int y1, linestep *s){
+   int majorStart, majorDir, majorLow, majorHigh;
+   long majorUnit, minorUnit;
+   if (abs(x1 - x0) >= abs(y1 - y0)){
+      majorStart = x0;
+      majorDir = (x0 < x1) ? 1 : -1;
+      majorLow = area->left;
+      majorHigh = area->right;
+      majorUnit = 1;
+      s->majorLength = abs(x1 - x0);
+      s->minorLength = abs(y1 - y0);
+      s->minorStart = y0;
+      s->minorDir = (y0 < y1) ? 1 : -1;
+      s->minorLow = area->top;
+      s->minorHigh = area->bottom;
+      minorUnit = fb->width;
+   }
+   else{
+      majorStart = y0;
+      majorDir = (y0 < y1) ? 1 : -1;
+      majorLow = area->top;
+      majorHigh = area->bottom;
+      majorUnit = fb->width;
+      s->majorLength = abs(y1 - y0);
+      s->minorLength = abs(x1 - x0);
+      s->minorStart = x0;
+      s->minorDir = (x0 < x1) ? 1 : -1;
+      s->minorLow = area->left;
+      s->minorHigh = area->right;
+      minorUnit = 1;
+   }
+   s->majorStride = majorDir * majorUnit;
+   s->minorStride = s->minorDir * minorUnit;
+   s->base = majorStart * majorUnit + s->minorStart * minorUnit;
+   if (majorDir > 0){
+      s->first = (long)majorLow - majorStart;
+      s->last = (long)majorHigh - 1 - majorStart;
+   }
+   else{
+      s->first = (long)majorStart - (majorHigh - 1);
+      s->last = (long)majorStart - majorLow;
+   }
+   if (s->first < 0){
+      s->first = 0;
+   }
+   if (s->last > s->majorLength){
+      s->last = s->majorLength;
+   }
+   return s->first <= s->last;
+}
+
+static void drawClipped(framebuffer *fb, rastertile *area, int x0, int y0,
+   int x1, int y1, unsigned int colour){
+   linestep s;
+   if (stepInside(fb, area, x0, y0, x1, y1, colour) == 1){
+      return;
+   }
+   if (clipLine(fb, area, x0, y0, x1, y1, &s) == 0){
+      return;
+   }
+   s.colour = colour;
+   switch (fb->path){
+#ifdef RASTERSIMD
+      case RASTER_AVX2:
+         stepAVX2(fb, &s);
+         break;
+      case RASTER_SSE2:
+         stepSSE2(fb, &s);
+         break;
+#endif
+      default:
+         stepScalar(fb, &s);
+         break;
+   }
+}
+
+static void queueSegment(framebuffer *fb, int x0, int y0, int x1, int y1){
+   rastersegment *seg;
+   if ((x0 < 0 && x1 < 0) || (y0 < 0 && y1 < 0)
+      || (x0 >= fb->width && x1 >= fb->width)
+      || (y0 >= fb->height && y1 >= fb->height)){
+      return;
+   }
+   if (fb->queue == NULL){
+      fb->queue = createQueue(fb);
+   }
+   if (fb->queue->count == RASTERQUEUE){
+      flushSegments(fb);
+   }
+   seg = &fb->queue->segments[fb->queue->count++];
+   seg->x0 = x0;
+   seg->y0 = y0;
+   seg->x1 = x1;
+   seg->y1 = y1;
+   seg->colour = fb->colour;
+}
+
+static struct rasterqueue *createQueue(framebuffer *fb){
+   struct rasterqueue *q;
+   int size, across, down, i, parts;
+   size = TILEMAXIMUM;
+   while (size > TILEMINIMUM && (long)((fb->width + size - 1) / size)
+      * ((fb->height + size - 1) / size) < (long)fb->threads * TILESPERTHREAD){
+      size /= 2;
+   }
+   across = (fb->width + size - 1) / size;
+   down = (fb->height + size - 1) / size;
+   parts = fb->threads;
+   q = (struct rasterqueue *)calloc(1, sizeof(struct rasterqueue));
+   if (q == NULL || (q->segments = (rastersegment *)malloc(RASTERQUEUE
+      * sizeof(rastersegment))) == NULL || (q->tiles = (rastertile *)calloc(
+      parts * across * down, sizeof(rastertile))) == NULL
+      || pthread_mutex_init(&q->lock, NULL) != 0){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      exit(EXIT_FAILURE);
+   }
+   q->tileSize = size;
+   q->across = across;
+   q->tileCount = across * down;
+   q->parts = parts;
+   for (i = 0; i < parts * q->tileCount; i++){
+      q->tiles[i].left = (i % q->tileCount % across) * size;
+      q->tiles[i].top = (i % q->tileCount / across) * size;
+      q->tiles[i].right = q->tiles[i].left + size;
+      q->tiles[i].bottom = q->tiles[i].top + size;
+      if (q->tiles[i].right > fb->width){
+         q->tiles[i].right = fb->width;
+      }
+      if (q->tiles[i].bottom > fb->height){
+         q->tiles[i].bottom = fb->height;
+      }
+   }
+   return q;
+}
+
+static void freeQueue(struct rasterqueue *q){
+   int i;
+   if (q == NULL){
+      return;
+   }
+   for (i = 0; i < q->parts * q->tileCount; i++){
+      free(q->tiles[i].items);
+   }
+   pthread_mutex_destroy(&q->lock);
+   free(q->tiles);
+   free(q->segments);
+   free(q);
+}
+
+static void runWorkers(framebuffer *fb, void *(*work)(void *), int jobs){
+   pthread_t workers[RASTERMAXTHREADS];
+   int i, started = 0;
+   for (i = 1; i < fb->threads && i < jobs; i++){
+      if (pthread_create(&workers[started], NULL, work, fb) == 0){
+         started++;
+      }
+   }
+   work(fb);
+   for (i = 0; i < started; i++){
+      pthread_join(workers[i], NULL);
+   }
+}
+
+static int nextJob(struct rasterqueue *q, int count){
+   int job;
+   pthread_mutex_lock(&q->lock);
+   job = q->next++;
+   pthread_mutex_unlock(&q->lock);
+   return (job < count) ? job : -1;
+}
+
+static void *binWorker(void *arg){
+   framebuffer *fb = (framebuffer *)arg;
+   int part;
+   while ((part = nextJob(fb->queue, fb->queue->parts)) >= 0){
+      binSegments(fb, part);
+   }
+   return NULL;
+}
+
+static void binSegments(framebuffer *fb, int part){
+   struct rasterqueue *q = fb->queue;
+   rastertile *tiles;
+   rastersegment *seg;
+   int size, a0, a1, b0, b1, aLimit, bLimit, lo, hi, band, from, to, t;
+   double bFrom, bTo, low, high;
+   int xMajor;
+   long i, end;
+   size = q->tileSize;
+   tiles = &q->tiles[part * q->tileCount];
+   end = q->count * (part + 1) / q->parts;
+   for (i = q->count * part / q->parts; i < end; i++){
+      seg = &q->segments[i];
+      xMajor = abs(seg->x1 - seg->x0) >= abs(seg->y1 - seg->y0);
+      a0 = xMajor ? seg->x0 : seg->y0;
+      a1 = xMajor ? seg->x1 : seg->y1;
+      b0 = xMajor ? seg->y0 : seg->x0;
+      b1 = xMajor ? seg->y1 : seg->x1;
+      aLimit = xMajor ? fb->width : fb->height;
+      bLimit = xMajor ? fb->height : fb->width;
+      lo = (a0 < a1) ? a0 : a1;
+      hi = (a0 < a1) ? a1 : a0;
+      lo = (lo < 0) ? 0 : lo;
+      hi = (hi >= aLimit) ? aLimit - 1 : hi;
+      for (band = lo / size; lo <= hi && band <= hi / size; band++){
+         from = (band * size > lo) ? band * size : lo;
+         to = (band * size + size - 1 < hi) ? band * size + size - 1 : hi;
+         bFrom = b0;
+         bTo = b0;
+         if (a1 != a0){
+            bFrom = b0 + (double)(from - a0) * (b1 - b0) / (a1 - a0);
+            bTo = b0 + (double)(to - a0) * (b1 - b0) / (a1 - a0);
+         }
+         low = floor((bFrom < bTo) ? bFrom : bTo) - 1;
+         high = ceil((bFrom < bTo) ? bTo : bFrom) + 1;
+         low = (low < 0) ? 0 : low;
+         high = (high > bLimit - 1) ? bLimit - 1 : high;
+         for (t = (int)low / size; low <= high && t <= (int)high / size; t++){
+            binTile(xMajor ? &tiles[t * q->across + band]
+               : &tiles[band * q->across + t], i);
+         }
+      }
+   }
+}
+
+static void binTile(rastertile *tile, long i){
+   if (tile->count == tile->capacity){
+      tile->capacity = (tile->capacity == 0) ? TILEMINIMUM
+         : tile->capacity * 2;
+      tile->items = (long *)realloc(tile->items, tile->capacity
+         * sizeof(long));
+      if (tile->items == NULL){
+         fprintf(stderr, "Could not allocate memory...exiting\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   tile->items[tile->count++] = i;
+}
+
+static void *drawWorker(void *arg){
+   framebuffer *fb = (framebuffer *)arg;
+   int t, part;
+   while ((t = nextJob(fb->queue, fb->queue->tileCount)) >= 0){
+      for (part = 0; part < fb->queue->parts; part++){
+         drawTile(fb, &fb->queue->tiles[part * fb->queue->tileCount + t]);
+      }
+   }
+   return NULL;
+}
+
+static void drawTile(framebuffer *fb, rastertile *tile){
+   rastersegment *seg;
+   long i;
+   for (i = 0; i < tile->count; i++){
+      seg = &fb->queue->segments[tile->items[i]];
+      drawClipped(fb, tile, seg->x0, seg->y0, seg->x1, seg->y1, seg->colour);
+   }
+}
+
+static void seekLine(linestep *s, long i){
+   double n, m, k = 0.0;
+   n = s->majorLength + 2.0 * s->minorLength * i;
+   m = 2.0 * s->majorLength;
+   if (s->majorLength > 0){
+      k = floor(n / m);
+      while (k * m > n){
+         k = k - 1;
+      }
+      while ((k + 1) * m <= n){
+         k = k + 1;
+      }
+   }
+   s->err = (int)(n - k * m);
+   s->minor = s->minorStart + s->minorDir * (int)k;
+   s->addr = s->base + (long)k * s->minorStride + i * s->majorStride;
+}
+
+static void stepScalar(framebuffer *fb, linestep *s){
+   long i;
+   seekLine(s, s->first);
+   for (i = s->first; i <= s->last; i++){
+      if (s->minor >= s->minorLow && s->minor < s->minorHigh){
+         fb->pixels[s->addr] = s->colour;
+      }
+      advanceLine(s);
+   }
+}
+
+static int stepInside(framebuffer *fb, rastertile *area, int x0, int y0,
+   int x1, int y1, unsigned int colour){
+   int major, minor, err, i;
+   long addr, majorStride, minorStride;
+   if (x0 < area->left || x0 >= area->right || x1 < area->left
+      || x1 >= area->right || y0 < area->top || y0 >= area->bottom
+      || y1 < area->top || y1 >= area->bottom){
+      return 0;
+   }
+   major = abs(x1 - x0);
+   minor = abs(y1 - y0);
+   majorStride = (x0 < x1) ? 1 : -1;
+   minorStride = (y0 < y1) ? fb->width : -fb->width;
+   if (minor > major){
+      major = abs(y1 - y0);
+      minor = abs(x1 - x0);
+      majorStride = (y0 < y1) ? fb->width : -fb->width;
+      minorStride = (x0 < x1) ? 1 : -1;
+   }
+   if (fb->path != RASTER_SCALAR && major + 1 >= SIMDMINIMUM){
+      return 0;
+   }
+   addr = (long)y0 * fb->width + x0;
+   err = major;
+   for (i = 0; i <= major; i++){
+      fb->pixels[addr] = colour;
+      addr += majorStride;
+      err += 2 * minor;
+      if (err >= 2 * major){
+         err -= 2 * major;
+         addr += minorStride;
+      }
+   }
+   return 1;
+}
+
+static void advanceLine(linestep *s){
+   s->addr += s->majorStride;
+   s->err += 2 * s->minorLength;
+   if (s->err >= 2 * s->majorLength){
+      s->err -= 2 * s->majorLength;
+      s->minor += s->minorDir;
+      s->addr += s->minorStride;
+   }
+}
+
+#ifdef RASTERSIMD
+__attribute__((target("sse2")))
+static void stepSSE2(framebuffer *fb, linestep *s){
+   __m128i err, minor, addr, mask, errStep, minorJump, addrJump, twoMajor;
+   __m128i overflow, minorDir, minorStride, limit, below, colour;
+   unsigned int errs[SSELANES], minors[SSELANES], addrs[SSELANES];
+   long groups, g, jump, start, i;
+   int j, bits;
+   groups = (s->last - s->first + 1) / SSELANES;
+   if (s->last - s->first + 1 < SIMDMINIMUM){
+      stepScalar(fb, s);
+      return;
+   }
+   if (s->minorLength == 0 && (s->majorStride == 1 || s->majorStride == -1)){
+      seekLine(s, s->first);
+      if (s->minor < s->minorLow || s->minor >= s->minorHigh){
+         return;
+      }
+      start = (s->majorStride > 0) ? s->addr : s->addr - (s->last - s->first);
+      colour = _mm_set1_epi32((int)s->colour);
+      for (i = 0; i + SSELANES <= s->last - s->first + 1; i += SSELANES){
+         _mm_storeu_si128((__m128i *)&fb->pixels[start + i], colour);
+      }
+      for (; i <= s->last - s->first; i++){
+         fb->pixels[start + i] = s->colour;
+      }
+      return;
+   }
+   seekLine(s, s->first);
+   for (j = 0; j < SSELANES; j++){
+      errs[j] = (unsigned int)s->err;
+      minors[j] = (unsigned int)s->minor;
+      addrs[j] = (unsigned int)s->addr;
+      advanceLine(s);
+   }
+   err = _mm_loadu_si128((__m128i *)errs);
+   minor = _mm_loadu_si128((__m128i *)minors);
+   addr = _mm_loadu_si128((__m128i *)addrs);
+   jump = 2L * s->minorLength * SSELANES;
+   errStep = _mm_set1_epi32((int)(jump % (2L * s->majorLength)));
+   jump = jump / (2L * s->majorLength);
+   minorJump = _mm_set1_epi32((int)(jump * s->minorDir));
+   addrJump = _mm_set1_epi32((int)(unsigned int)(SSELANES * s->majorStride
+      + jump * s->minorStride));
+   twoMajor = _mm_set1_epi32(2 * s->majorLength);
+   overflow = _mm_set1_epi32(2 * s->majorLength - 1);
+   minorDir = _mm_set1_epi32(s->minorDir);
+   minorStride = _mm_set1_epi32((int)s->minorStride);
+   limit = _mm_set1_epi32(s->minorHigh);
+   below = _mm_set1_epi32(s->minorLow - 1);
+   for (g = 0; g < groups; g++){
+      mask = _mm_and_si128(_mm_cmpgt_epi32(minor, below),
+         _mm_cmpgt_epi32(limit, minor));
+      bits = _mm_movemask_ps(_mm_castsi128_ps(mask));
+      if (bits == (1 << SSELANES) - 1){
+         _mm_storeu_si128((__m128i *)addrs, addr);
+         for (j = 0; j < SSELANES; j++){
+            fb->pixels[addrs[j]] = s->colour;
+         }
+      }
+      else if (bits != 0){
+         _mm_storeu_si128((__m128i *)addrs, addr);
+         for (j = 0; j < SSELANES; j++){
+            if (bits & (1 << j)){
+               fb->pixels[addrs[j]] = s->colour;
+            }
+         }
+      }
+      err = _mm_add_epi32(err, errStep);
+      minor = _mm_add_epi32(minor, minorJump);
+      addr = _mm_add_epi32(addr, addrJump);
+      mask = _mm_cmpgt_epi32(err, overflow);
+      err = _mm_sub_epi32(err, _mm_and_si128(mask, twoMajor));
+      minor = _mm_add_epi32(minor, _mm_and_si128(mask, minorDir));
+      addr = _mm_add_epi32(addr, _mm_and_si128(mask, minorStride));
+   }
+   s->first += groups * SSELANES;
+   stepScalar(fb, s);
+}
+
+__attribute__((target("avx2")))
+static void stepAVX2(framebuffer *fb, linestep *s){
+   __m256i err, minor, addr, mask, errStep, minorJump, addrJump, twoMajor;
+   __m256i overflow, minorDir, minorStride, limit, below, colour;
+   unsigned int errs[AVXLANES], minors[AVXLANES], addrs[AVXLANES];
+   long groups, g, jump, start, i;
+   int j, bits;
+   groups = (s->last - s->first + 1) / AVXLANES;
+   if (s->last - s->first + 1 < SIMDMINIMUM){
+      stepScalar(fb, s);
+      return;
+   }
+   if (s->minorLength == 0 && (s->majorStride == 1 || s->majorStride == -1)){
+      seekLine(s, s->first);
+      if (s->minor < s->minorLow || s->minor >= s->minorHigh){
+         return;
+      }
+      start = (s->majorStride > 0) ? s->addr : s->addr - (s->last - s->first);
+      colour = _mm256_set1_epi32((int)s->colour);
+      for (i = 0; i + AVXLANES <= s->last - s->first + 1; i += AVXLANES){
+         _mm256_storeu_si256((__m256i *)&fb->pixels[start + i], colour);
+      }
+      for (; i <= s->last - s->first; i++){
+         fb->pixels[start + i] = s->colour;
+      }
+      return;
+   }
+   seekLine(s, s->first);
+   for (j = 0; j < AVXLANES; j++){
+      errs[j] = (unsigned int)s->err;
+      minors[j] = (unsigned int)s->minor;
+      addrs[j] = (unsigned int)s->addr;
+      advanceLine(s);
+   }
+   err = _mm256_loadu_si256((__m256i *)errs);
+   minor = _mm256_loadu_si256((__m256i *)minors);
+   addr = _mm256_loadu_si256((__m256i *)addrs);
+   jump = 2L * s->minorLength * AVXLANES;
+   errStep = _mm256_set1_epi32((int)(jump % (2L * s->majorLength)));
+   jump = jump / (2L * s->majorLength);
+   minorJump = _mm256_set1_epi32((int)(jump * s->minorDir));
+   addrJump = _mm256_set1_epi32((int)(unsigned int)(AVXLANES * s->majorStride
+      + jump * s->minorStride));
+   twoMajor = _mm256_set1_epi32(2 * s->majorLength);
+   overflow = _mm256_set1_epi32(2 * s->majorLength - 1);
+   minorDir = _mm256_set1_epi32(s->minorDir);
+   minorStride = _mm256_set1_epi32((int)s->minorStride);
+   limit = _mm256_set1_epi32(s->minorHigh);
+   below = _mm256_set1_epi32(s->minorLow - 1);
+   for (g = 0; g < groups; g++){
+      mask = _mm256_and_si256(_mm256_cmpgt_epi32(minor, below),
+         _mm256_cmpgt_epi32(limit, minor));
+      bits = _mm256_movemask_ps(_mm256_castsi256_ps(mask));
+      if (bits == (1 << AVXLANES) - 1){
+         _mm256_storeu_si256((__m256i *)addrs, addr);
+         for (j = 0; j < AVXLANES; j++){
+            fb->pixels[addrs[j]] = s->colour;
+         }
+      }
+      else if (bits != 0){
+         _mm256_storeu_si256((__m256i *)addrs, addr);
+         for (j = 0; j < AVXLANES; j++){
+            if (bits & (1 << j)){
+               fb->pixels[addrs[j]] = s->colour;
+            }
+         }
+      }
+      err = _mm256_add_epi32(err, errStep);
+      minor = _mm256_add_epi32(minor, minorJump);
+      addr = _mm256_add_epi32(addr, addrJump);
+      mask = _mm256_cmpgt_epi32(err, overflow);
+      err = _mm256_sub_epi32(err, _mm256_and_si256(mask, twoMajor));
+      minor = _mm256_add_epi32(minor, _mm256_and_si256(mask, minorDir));
+      addr = _mm256_add_epi32(addr, _mm256_and_si256(mask, minorStride));
+   }
+   s->first += groups * AVXLANES;
+   stepScalar(fb, s);
+}
+#endif
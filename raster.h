@@ -0,0 +1,92 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "segment.h"
+
+#define RASTERLIMIT 1048576
+#define RGBA 4
+#define PNGSTORED 65535
+
+/*The ways rasterLine can step along a line. The SIMD paths step several
+pixels at once and draw exactly the same pixels as RASTER_SCALAR.*/
+enum rasterpath {RASTER_SCALAR, RASTER_SSE2, RASTER_AVX2};
+typedef enum rasterpath rasterpath;
+
+/*An in-memory RGBA image. Each pixel is stored as four bytes in the order
+red, green, blue, alpha. Coordinates given to rasterSegment are in window
+units and are scaled by scaleX and scaleY to the size of the image.*/
+struct framebuffer{
+   int width;
+   int height;
+   double scaleX;
+   double scaleY;
+   unsigned int *pixels;
+   unsigned int colour;
+   rasterpath path;
+   int threads;
+   struct rasterqueue *queue;
+};
+typedef struct framebuffer framebuffer;
+
+/*Returns a framebuffer of width by height pixels cleared to opaque black. The
+window of winWidth by winHeight units is stretched to fill it.*/
+framebuffer *createFramebuffer(int width, int height, int winWidth,
+   int winHeight);
+
+/*Makes rasterLine use path. Returns 0, leaving the path unchanged, if this
+machine or this framebuffer cannot use it. New framebuffers use RASTER_SSE2
+where the machine has it. Pixels are still stored one at a time, so the wider
+AVX2 lanes measure no faster in rasterbench.*/
+int setRasterPath(framebuffer *fb, rasterpath path);
+
+/*Makes rasterSegment queue its lines and draw them threads at a time. The
+queue is split into tiles that each draw their own lines in the order they
+were queued, so the image is the same as drawing them one by one. 1 draws
+every line straight away. Returns 0 if threads is less than 1. New
+framebuffers use one thread per processor.*/
+int setRasterThreads(framebuffer *fb, int threads);
+
+/*Draws every line rasterSegment has queued. writeImage does this first.*/
+void flushSegments(framebuffer *fb);
+
+/*Sets the colour used by following lines*/
+void setRasterColour(framebuffer *fb, int r, int g, int b);
+
+/*Returns the pixel value for a colour*/
+unsigned int packColour(int r, int g, int b);
+
+/*Scales a segment given in window units to the framebuffer and draws it, or
+queues it if the framebuffer draws with more than one thread*/
+void rasterSegment(framebuffer *fb, double x0, double y0, double x1,
+   double y1);
+
+/*Draws lines first to last - 1 of a segment buffer in their palette colours
+with rasterSegment, which leaves the colour at that of the last line. A
+buffer can be drawn into framebuffers of any size.*/
+void rasterSegments(framebuffer *fb, segmentbuffer *s, long first, long last);
+
+/*Draws a line between two pixels with the current colour. Pixels are chosen
+by stepping along the major axis and rounding the minor axis to the nearest
+pixel, rounding halves away from the start. Pixels outside the framebuffer are
+skipped.*/
+void rasterLine(framebuffer *fb, int x0, int y0, int x1, int y1);
+
+/*Draws a line exactly like rasterLine but one pixel at a time with Bresenham's
+algorithm. This is the reference the other paths are tested against.*/
+void rasterLineReference(framebuffer *fb, int x0, int y0, int x1, int y1);
+
+/*Writes the framebuffer to a file. Names ending in .png are written as PNG,
+anything else as binary PPM. Returns 0 if the file could not be written.*/
+int writeImage(framebuffer *fb, char *filename);
+
+/*Writes the framebuffer as a binary PPM. The alpha channel is dropped.*/
+int writePPM(framebuffer *fb, char *filename);
+
+/*Writes the framebuffer as an RGBA PNG made of stored deflate blocks, so no
+compression library is needed.*/
+int writePNG(framebuffer *fb, char *filename);
+
+/*Frees a framebuffer and its pixels*/
+void freeFramebuffer(framebuffer *fb);
+
+#endif
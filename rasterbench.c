@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "raster.h"
+
+#define BENCHWIDTH 800
+#define BENCHHEIGHT 600
+#define BENCHLINES 100000
+#define BENCHREPEATS 20
+#define SHORTLINE 16
+#define LONGLINE 400
+#define PATHCOUNT 3
+#define THREADLINES 1000000
+
+/*Fills lines with the end points of count random segments of up to length
+pixels along each axis. Returns the number of pixels the segments step over.*/
+long makeLines(int *lines, int count, int length);
+
+/*Draws the lines BENCHREPEATS times with the given path, or with
+rasterLineReference if reference is 1, and prints segments and pixels per
+second. Paths this machine cannot use are reported as unsupported.*/
+void timePath(framebuffer *fb, rasterpath path, int reference, int *lines,
+   int count, long pixels);
+
+/*Queues the lines with rasterSegment and draws them on 1, 2, 4 and so on
+threads up to the number of processors. Prints segments per second and the
+speed up over one thread.*/
+void timeThreads(char *size, int *lines, int count);
+
+/*Returns the wall clock time in seconds*/
+double now(void);
+
+int main(void){
+   static char *sizes[2] = {"short", "long"};
+   int lengths[2] = {SHORTLINE, LONGLINE};
+   framebuffer *fb;
+   int *lines, size, path;
+   long pixels;
+   lines = (int *)malloc(BENCHLINES * 4 * sizeof(int));
+   if (lines == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      return EXIT_FAILURE;
+   }
+   fb = createFramebuffer(BENCHWIDTH, BENCHHEIGHT, BENCHWIDTH, BENCHHEIGHT);
+   srand(1);
+   printf("%-6s %-10s %14s %14s\n", "lines", "path", "segments/s",
+      "pixels/s");
+   for (size = 0; size < 2; size++){
+      pixels = makeLines(lines, BENCHLINES, lengths[size]);
+      printf("%-6s ", sizes[size]);
+      timePath(fb, RASTER_SCALAR, 1, lines, BENCHLINES, pixels);
+      for (path = RASTER_SCALAR; path < PATHCOUNT; path++){
+         printf("%-6s ", sizes[size]);
+         timePath(fb, (rasterpath)path, 0, lines, BENCHLINES, pixels);
+      }
+   }
+   freeFramebuffer(fb);
+   free(lines);
+   lines = (int *)malloc(THREADLINES * 4 * sizeof(int));
+   if (lines == NULL){
+      fprintf(stderr, "Could not allocate memory...exiting\n");
+      return EXIT_FAILURE;
+   }
+   printf("\n%-6s %-7s %14s %8s\n", "lines", "threads", "segments/s",
+      "speedup");
+   for (size = 0; size < 2; size++){
+      makeLines(lines, THREADLINES, lengths[size]);
+      timeThreads(sizes[size], lines, THREADLINES);
+   }
+   free(lines);
+   return 0;
+}
+
+long makeLines(int *lines, int count, int length){
+   long pixels = 0;
+   int i, dx, dy;
+   for (i = 0; i < count; i++){
+      lines[i * 4] = rand() % BENCHWIDTH;
+      lines[i * 4 + 1] = rand() % BENCHHEIGHT;
+      lines[i * 4 + 2] = lines[i * 4] + rand() % (2 * length + 1) - length;
+      lines[i * 4 + 3] = lines[i * 4 + 1] + rand() % (2 * length + 1) - length;
+      dx = abs(lines[i * 4 + 2] - lines[i * 4]);
+      dy = abs(lines[i * 4 + 3] - lines[i * 4 + 1]);
+      pixels += ((dx > dy) ? dx : dy) + 1;
+   }
+   return pixels;
+}
+
+void timePath(framebuffer *fb, rasterpath path, int reference, int *lines,
+   int count, long pixels){
+   static char *names[PATHCOUNT] = {"scalar", "sse2", "avx2"};
+   double start, seconds;
+   int i, r;
+   printf("%-10s ", reference == 1 ? "reference" : names[path]);
+   if (setRasterPath(fb, path) == 0){
+      printf("%14s\n", "unsupported");
+      return;
+   }
+   start = now();
+   for (r = 0; r < BENCHREPEATS; r++){
+      for (i = 0; i < count; i++){
+         if (reference == 1){
+            rasterLineReference(fb, lines[i * 4], lines[i * 4 + 1],
+               lines[i * 4 + 2], lines[i * 4 + 3]);
+         }
+         else{
+            rasterLine(fb, lines[i * 4], lines[i * 4 + 1], lines[i * 4 + 2],
+               lines[i * 4 + 3]);
+         }
+      }
+   }
+   seconds = now() - start;
+   printf("%14.0f %14.0f\n", (double)count * BENCHREPEATS / seconds,
+      (double)pixels * BENCHREPEATS / seconds);
+}
+
+void timeThreads(char *size, int *lines, int count){
+   framebuffer *fb;
+   double start, seconds, single = 0.0;
+   int threads, processors, i;
+   processors = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   for (threads = 1; threads == 1 || threads <= processors; threads *= 2){
+      fb = createFramebuffer(BENCHWIDTH, BENCHHEIGHT, BENCHWIDTH,
+         BENCHHEIGHT);
+      setRasterThreads(fb, threads);
+      start = now();
+      for (i = 0; i < count; i++){
+         rasterSegment(fb, lines[i * 4], lines[i * 4 + 1], lines[i * 4 + 2],
+            lines[i * 4 + 3]);
+      }
+      flushSegments(fb);
+      seconds = now() - start;
+      if (threads == 1){
+         single = seconds;
+      }
+      printf("%-6s %-7d %14.0f %8.2f\n", size, threads, count / seconds,
+         single / seconds);
+      freeFramebuffer(fb);
+   }
+}
+
+double now(void){
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
@@ -0,0 +1,76 @@
+#include "rng.h"
+
+#define WORDMASK 0xffffffffUL
+#define HALFMASK 0xffffUL
+#define PHILOXROUNDS 10
+#define PHILOXM0 0xD2511F53UL
+#define PHILOXM1 0xCD9E8D57UL
+#define PHILOXW0 0x9E3779B9UL
+#define PHILOXW1 0xBB67AE85UL
+#define TWO21 2097152.0
+#define TWO53 9007199254740992.0
+
+/*Sets hi and lo to the high and low 32 bits of the 64 bit product of two 32
+bit words. C90 has no 64 bit type, so the words are multiplied in halves.*/
+static void multiplyWords(unsigned long a, unsigned long b, unsigned long *hi,
+   unsigned long *lo);
+
+/*Returns the high 32 bits of a value that may be wider than 32 bits*/
+static unsigned long highWord(unsigned long x);
+
+void randomBits(unsigned long seed, unsigned long instruction,
+   unsigned long iteration, unsigned long *out){
+   unsigned long key0, key1, hi0, lo0, hi1, lo1;
+   int r;
+   out[0] = instruction & WORDMASK;
+   out[1] = iteration & WORDMASK;
+   out[2] = highWord(iteration);
+   out[3] = 0;
+   key0 = seed & WORDMASK;
+   key1 = highWord(seed);
+   for (r = 0; r < PHILOXROUNDS; r++){
+      if (r > 0){
+         key0 = (key0 + PHILOXW0) & WORDMASK;
+         key1 = (key1 + PHILOXW1) & WORDMASK;
+      }
+      multiplyWords(PHILOXM0, out[0], &hi0, &lo0);
+      multiplyWords(PHILOXM1, out[2], &hi1, &lo1);
+      out[0] = hi1 ^ out[1] ^ key0;
+      out[1] = lo1;
+      out[2] = hi0 ^ out[3] ^ key1;
+      out[3] = lo0;
+   }
+}
+
+double randomUnit(unsigned long seed, unsigned long instruction,
+   unsigned long iteration){
+   unsigned long bits[RANDOMWORDS];
+   randomBits(seed, instruction, iteration, bits);
+   return ((double)bits[0] * TWO21 + (double)(bits[1] >> 11)) / TWO53;
+}
+
+long randomRange(unsigned long seed, unsigned long instruction,
+   unsigned long iteration, long low, long high){
+   double span;
+   if (high <= low){
+      return low;
+   }
+   span = (double)high - (double)low + 1.0;
+   return low + (long)(randomUnit(seed, instruction, iteration) * span);
+}
+
+static void multiplyWords(unsigned long a, unsigned long b, unsigned long *hi,
+   unsigned long *lo){
+   unsigned long aLow = a & HALFMASK, aHigh = (a >> 16) & HALFMASK;
+   unsigned long bLow = b & HALFMASK, bHigh = (b >> 16) & HALFMASK;
+   unsigned long low, middle, cross;
+   low = aLow * bLow;
+   cross = aHigh * bLow;
+   middle = (low >> 16) + (cross & HALFMASK) + aLow * bHigh;
+   *lo = ((middle & HALFMASK) << 16 | (low & HALFMASK)) & WORDMASK;
+   *hi = (aHigh * bHigh + (cross >> 16) + (middle >> 16)) & WORDMASK;
+}
+
+static unsigned long highWord(unsigned long x){
+   return ((x >> 16) >> 16) & WORDMASK;
+}
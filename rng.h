@@ -0,0 +1,23 @@
+#ifndef RNG_H
+#define RNG_H
+
+#define RANDOMWORDS 4
+
+/*Fills out with RANDOMWORDS words of 32 random bits. They depend only on the
+seed and on the position of the draw in the execution, given as the index of
+the instruction and the iteration it runs in, so the same draw gives the same
+bits in any order, on any thread and with no state to share.*/
+void randomBits(unsigned long seed, unsigned long instruction,
+   unsigned long iteration, unsigned long *out);
+
+/*Returns a random number in [0, 1) with 53 random bits for a position in the
+execution, as randomBits*/
+double randomUnit(unsigned long seed, unsigned long instruction,
+   unsigned long iteration);
+
+/*Returns a random whole number from low to high inclusive for a position in
+the execution, as randomBits*/
+long randomRange(unsigned long seed, unsigned long instruction,
+   unsigned long iteration, long low, long high);
+
+#endif
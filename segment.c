@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "segment.h"
+
+#define COLOURTOP 255
+
+/*Returns array resized to hold capacity items of size bytes. Quits if it
+cannot be resized.*/
+static void *growArray(void *array, long capacity, size_t size);
+
+/*Quits the program when memory cannot be allocated*/
+static void segmentQuit(void);
+
+segmentbuffer *createSegments(void){
+   segmentbuffer *s;
+   s = (segmentbuffer *)calloc(1, sizeof(segmentbuffer));
+   if (s == NULL){
+      segmentQuit();
+   }
+   setSegmentColour(s, COLOURTOP, COLOURTOP, COLOURTOP);
+   return s;
+}
+
+void addSegment(segmentbuffer *s, double x0, double y0, double x1, double y1){
+   if (s->count == s->capacity){
+      s->capacity = (s->capacity == 0) ? SEGMENTSTART : s->capacity * 2;
+      s->x0 = (float *)growArray(s->x0, s->capacity, sizeof(float));
+      s->y0 = (float *)growArray(s->y0, s->capacity, sizeof(float));
+      s->x1 = (float *)growArray(s->x1, s->capacity, sizeof(float));
+      s->y1 = (float *)growArray(s->y1, s->capacity, sizeof(float));
+      s->colours = (unsigned char *)growArray(s->colours, s->capacity,
+         sizeof(unsigned char));
+   }
+   s->x0[s->count] = (float)x0;
+   s->y0[s->count] = (float)y0;
+   s->x1[s->count] = (float)x1;
+   s->y1[s->count] = (float)y1;
+   s->colours[s->count++] = (unsigned char)s->colour;
+}
+
+int setSegmentColour(segmentbuffer *s, int r, int g, int b){
+   int i;
+   for (i = 0; i < s->paletteSize; i++){
+      if (s->palette[i][0] == r && s->palette[i][1] == g
+         && s->palette[i][2] == b){
+         s->colour = i;
+         return 1;
+      }
+   }
+   if (s->paletteSize == PALETTESIZE){
+      return 0;
+   }
+   s->palette[i][0] = (unsigned char)r;
+   s->palette[i][1] = (unsigned char)g;
+   s->palette[i][2] = (unsigned char)b;
+   s->colour = s->paletteSize++;
+   return 1;
+}
+
+void freeSegments(segmentbuffer *s){
+   if (s == NULL){
+      return;
+   }
+   free(s->x0);
+   free(s->y0);
+   free(s->x1);
+   free(s->y1);
+   free(s->colours);
+   free(s);
+}
+
+static void *growArray(void *array, long capacity, size_t size){
+   void *grown;
+   grown = realloc(array, capacity * size);
+   if (grown == NULL){
+      segmentQuit();
+   }
+   return grown;
+}
+
+static void segmentQuit(void){
+   fprintf(stderr, "Could not allocate memory...exiting\n");
+   exit(EXIT_FAILURE);
+}
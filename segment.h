@@ -0,0 +1,43 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#define SEGMENTSTART 1024
+#define PALETTESIZE 256
+#define RGB 3
+
+/*The lines a program draws, in the order it draws them. They are kept as
+parallel arrays so any backend can draw them, again and at any size, without
+the program being run again. Line i runs from (x0[i], y0[i]) to (x1[i], y1[i])
+in window units and is drawn in entry colours[i] of the palette, so a line
+takes 17 bytes. The palette holds each colour lines have been drawn in once,
+and colour is the entry new lines are drawn in.*/
+struct segmentbuffer{
+   float *x0;
+   float *y0;
+   float *x1;
+   float *y1;
+   unsigned char *colours;
+   long count;
+   long capacity;
+   unsigned char palette[PALETTESIZE][RGB];
+   int paletteSize;
+   int colour;
+};
+typedef struct segmentbuffer segmentbuffer;
+
+/*Returns an empty segment buffer whose palette holds white, the colour lines
+are drawn in until another is set*/
+segmentbuffer *createSegments(void);
+
+/*Adds a line in the current colour to the end of the buffer*/
+void addSegment(segmentbuffer *s, double x0, double y0, double x1, double y1);
+
+/*Makes following lines use the colour r, g, b, adding it to the palette if it
+is not there yet. Returns 0, leaving the colour unchanged, if the palette is
+full.*/
+int setSegmentColour(segmentbuffer *s, int r, int g, int b);
+
+/*Frees a segment buffer and its arrays*/
+void freeSegments(segmentbuffer *s);
+
+#endif